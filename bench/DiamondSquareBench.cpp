@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2018 Brendan Barnes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+// Diamond-square kernel microbenchmark
+// Usage: bench_diamond_square [detailLevel] [repetitions] [threads] [tileSize]
+// Times DiamondSquare::Generate with each supported instruction set, then
+// the cache blocked traversal against the plain level by level sweep, and
+// checks every heightmap against the scalar sweep bit for bit.
+
+#include "DiamondSquare.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static double TimeGenerate(DiamondSquare& generator, HeightField& map, int detailLevel, int repetitions)
+{
+    double best = 1e30;
+    for(int i = 0; i < repetitions; i++)
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        generator.Generate(map, detailLevel, 0.7f, 1234u);
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        best = elapsed.count() < best ? elapsed.count() : best;
+    }
+    return best;
+}
+
+static bool SameHeights(const HeightField& a, const HeightField& b)
+{
+    for(int y = 0; y < a.GetHeight(); y++)
+    {
+        if(memcmp(a.Row(y), b.Row(y), a.GetWidth()*sizeof(float)) != 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    const int detailLevel = argc > 1 ? atoi(argv[1]) : 12;
+    const int repetitions = argc > 2 ? atoi(argv[2]) : 5;
+    const unsigned int threads = argc > 3 ? atoi(argv[3]) : 1;
+    const int tileSize = argc > 4 ? atoi(argv[4]) : 256;
+    const char* names[] = { "scalar", "sse4.1", "avx2" };
+
+    DiamondSquare generator;
+    generator.SetThreadCount(threads);
+    generator.SetCacheBlocking(0, 0);
+    HeightField reference;
+    HeightField map;
+
+    generator.SetSimdLevel(SimdLevel::SCALAR);
+    const double scalarTime = TimeGenerate(generator, reference, detailLevel, repetitions);
+    printf("level %d, %u thread(s), best of %d\n", detailLevel, threads, repetitions);
+    printf("%-8s %10.2f ms  1.00x\n", names[0], scalarTime);
+
+    const SimdLevel best = GetBestSimdLevel();
+    for(int level = (int)SimdLevel::SSE41; level <= (int)best; level++)
+    {
+        generator.SetSimdLevel((SimdLevel)level);
+        double time = TimeGenerate(generator, map, detailLevel, repetitions);
+        bool same = SameHeights(reference, map);
+        printf("%-8s %10.2f ms  %.2fx  %s\n", names[level], time, scalarTime/time, same ? "identical" : "MISMATCH");
+        if(!same)
+        {
+            return 1;
+        }
+    }
+
+    generator.SetSimdLevel(best);
+    generator.SetCacheBlocking(tileSize, 0);
+    double blockedTime = TimeGenerate(generator, map, detailLevel, repetitions);
+    bool same = SameHeights(reference, map);
+    printf("%-8s %10.2f ms  %.2fx  %s (%s, %dx%d tiles)\n", "blocked", blockedTime, scalarTime/blockedTime,
+        same ? "identical" : "MISMATCH", names[(int)best], tileSize, tileSize);
+    return same ? 0 : 1;
+}
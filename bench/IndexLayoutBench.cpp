@@ -0,0 +1,225 @@
+/*
+ * Copyright (c) 2018 Brendan Barnes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+// Grid index layout benchmark
+// Usage: bench_index_layout [detailLevel] [repetitions] [width] [height]
+// Compares the triangle list layout with restart separated triangle strips:
+// index bytes, triangle counts and winding on the CPU, then the time to draw
+// a generated terrain with the render shader into an offscreen framebuffer.
+// Runs without a window on a surfaceless EGL context, so it works headless.
+// Run from the repository root so the shader can be found.
+
+#include "GL/glew.h"
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include "Terrain.h"
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+// Signed area of triangle (a, b, c) of an n x n grid in (column, row) space
+static long long Winding(int n, unsigned int a, unsigned int b, unsigned int c)
+{
+    long long ax = a%n, ay = a/n, bx = b%n, by = b/n, cx = c%n, cy = c/n;
+    return (bx - ax)*(cy - ay) - (by - ay)*(cx - ax);
+}
+
+// Expands either layout into separate triangles and checks that every grid
+// quad is covered by two triangles wound the same way as the list layout
+static bool CheckLayout(int n, IndexLayout layout, size_t& triangles)
+{
+    std::vector<unsigned int> indices(GetGridIndexCount(n, layout));
+    BuildGridIndices(n, layout, indices.data());
+    std::vector<unsigned int> cover((size_t)(n-1)*(n-1), 0);
+    triangles = 0;
+    size_t start = 0;
+    for(size_t k = 0; k + 2 < indices.size(); k += layout == IndexLayout::TRIANGLE_LIST ? 3 : 1)
+    {
+        if(indices[k] == GRID_RESTART_INDEX || indices[k+1] == GRID_RESTART_INDEX || indices[k+2] == GRID_RESTART_INDEX)
+        {
+            start = k + 1;
+            continue;
+        }
+        unsigned int a = indices[k], b = indices[k+1], c = indices[k+2];
+        if(layout == IndexLayout::TRIANGLE_STRIP && (k - start)%2 == 1)
+        {
+            unsigned int swap = a; a = b; b = swap;
+        }
+        if(Winding(n, a, b, c) <= 0)
+        {
+            return false;
+        }
+        unsigned int column = a%n < b%n ? a%n : b%n, row = a/n < b/n ? a/n : b/n;
+        column = c%n < column ? c%n : column;
+        row = c/n < row ? c/n : row;
+        cover[(size_t)row*(n-1) + column]++;
+        triangles++;
+    }
+    for(size_t q = 0; q < cover.size(); q++)
+    {
+        if(cover[q] != 2)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool CreateContext(EGLDisplay& display, EGLContext& context)
+{
+    PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+    display = getPlatformDisplay ? getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr) : EGL_NO_DISPLAY;
+    if(display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr))
+    {
+        display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+        if(display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr))
+        {
+            return false;
+        }
+    }
+    eglBindAPI(EGL_OPENGL_API);
+    const EGLint attributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION, 4,
+        EGL_CONTEXT_MINOR_VERSION, 5,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+    context = eglCreateContext(display, EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, attributes);
+    if(context == EGL_NO_CONTEXT || !eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+    {
+        return false;
+    }
+    // GLEW also looks for a GLX display, which a surfaceless context lacks.
+    // The core entry points are loaded before that check.
+    glewExperimental = GL_TRUE;
+    glewInit();
+    return glGenBuffers != nullptr;
+}
+
+static double TimeDraw(Terrain& terrain, Shader& shader, int repetitions)
+{
+    double best = 1e30;
+    for(int i = 0; i < repetitions; i++)
+    {
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glFinish();
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        terrain.Render(&shader);
+        glFinish();
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        best = elapsed.count() < best ? elapsed.count() : best;
+    }
+    return best;
+}
+
+int main(int argc, char** argv)
+{
+    const int detailLevel = argc > 1 ? atoi(argv[1]) : 10;
+    const int repetitions = argc > 2 ? atoi(argv[2]) : 10;
+    const int width = argc > 3 ? atoi(argv[3]) : 800;
+    const int height = argc > 4 ? atoi(argv[4]) : 600;
+    const int n = (1 << detailLevel) + 1;
+    const IndexLayout layouts[] = { IndexLayout::TRIANGLE_LIST, IndexLayout::TRIANGLE_STRIP };
+    const char* names[] = { "list", "strip" };
+
+    printf("level %d, %dx%d vertices\n", detailLevel, n, n);
+    size_t listBytes = 0;
+    for(int l = 0; l < 2; l++)
+    {
+        size_t triangles = 0;
+        bool valid = CheckLayout(n, layouts[l], triangles);
+        size_t bytes = GetGridIndexCount(n, layouts[l])*sizeof(unsigned int);
+        listBytes = l == 0 ? bytes : listBytes;
+        printf("%-6s %12zu index bytes  %.2fx  %zu triangles  %s\n", names[l], bytes,
+            (double)listBytes/bytes, triangles, valid ? "valid" : "INVALID");
+        if(!valid)
+        {
+            return 1;
+        }
+    }
+
+    EGLDisplay display;
+    EGLContext context;
+    if(!CreateContext(display, context))
+    {
+        printf("No OpenGL 4.5 context, skipping draw timings\n");
+        return 0;
+    }
+    printf("%s, best of %d draws at %dx%d\n", glGetString(GL_RENDERER), repetitions, width, height);
+
+    // Offscreen target in place of a window
+    GLuint fbo, renderbuffers[2];
+    glGenFramebuffers(1, &fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, fbo);
+    glGenRenderbuffers(2, renderbuffers);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+    glBindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+    glViewport(0, 0, width, height);
+
+    // Same state and view as the viewer
+    glEnable(GL_CULL_FACE);
+    glCullFace(GL_FRONT);
+    glEnable(GL_DEPTH_TEST);
+    glDepthFunc(GL_LESS);
+    glEnable(GL_PRIMITIVE_RESTART_FIXED_INDEX);
+
+    int status = 0;
+    {
+        std::string shaderPath = "res/shaders/render.glsl";
+        Shader shader(shaderPath);
+        Terrain terrain;
+        terrain.GenTerrain(detailLevel, 0.7f, 1234u);
+        shader.Bind();
+        vmath::mat4 projection = vmath::perspective(60.0f, (float)width/(float)height, 0.001f, 100.0f) *
+            vmath::translate(vmath::vec3(0.0f, 0.0f, -2.0f)) * vmath::rotate(45.0f, vmath::vec3(-1.0f, 0.0f, 0.0f));
+        glUniformMatrix4fv(2, 1, GL_FALSE, projection);
+        glUniform1f(3, 0.0f);
+        glUniform1f(4, terrain.maxElevation);
+        glUniform1f(5, terrain.minElevation);
+
+        double listTime = 0.0;
+        for(int l = 0; l < 2; l++)
+        {
+            terrain.SetIndexLayout(layouts[l]);
+            TimeDraw(terrain, shader, 1);
+            double time = TimeDraw(terrain, shader, repetitions);
+            listTime = l == 0 ? time : listTime;
+            printf("%-6s %10.3f ms  %.2fx\n", names[l], time, listTime/time);
+        }
+        status = glGetError() == GL_NO_ERROR ? 0 : 1;
+        terrain.Release();
+    }
+
+    glDeleteRenderbuffers(2, renderbuffers);
+    glDeleteFramebuffers(1, &fbo);
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(display, context);
+    eglTerminate(display);
+    return status;
+}
@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2018 Brendan Barnes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#ifndef __CDLOD_QUADTREE__
+#define __CDLOD_QUADTREE__
+
+#include "HeightField.h"
+#include "Frustum.h"
+#include "ElevationBounds.h"
+#include "vmath.h"
+#include <vector>
+
+// Area of the heightmap drawn as one instance of the shared patch grid.
+// Laid out as the per-instance attributes the vertex shader reads.
+struct CdlodNode
+{
+    float x, y;         // Heightmap cell of the top left corner
+    float size;         // Cells per side, a multiple of the patch size
+    float lod;          // 0 is the full resolution
+    float morphStart;   // Distances over which the vertices morph into
+    float morphEnd;     // the next coarser LOD
+};
+
+struct CdlodStats
+{
+    int selectedNodes;  // Instances drawn, whole and quarter
+    int culledNodes;    // Nodes rejected by the frustum
+    size_t triangles;   // Triangles drawn
+};
+
+// Output of CdlodQuadtree::Select, reused between frames
+struct CdlodSelection
+{
+    // Drawn with the (patchSize + 1)^2 grid
+    std::vector<CdlodNode> nodes;
+    // Quarters of nodes whose other children are finer, drawn at the node's
+    // LOD with the (patchSize/2 + 1)^2 grid
+    std::vector<CdlodNode> quarterNodes;
+    CdlodStats stats;
+};
+
+// Continuous distance-dependent level of detail (Strugar, "Continuous
+// Distance-Dependent Level of Detail for Rendering Heightmaps", 2009).
+// A quadtree over a (2^k + 1)^2 heightmap keeps the elevation range of every
+// node. Each frame Select walks it from the root and picks, for every part
+// of the map, the coarsest LOD whose distance range covers it, so the
+// triangle count depends on the view rather than on the map size. All nodes
+// are drawn with one (patchSize + 1)^2 vertex grid scaled by 2^lod, and the
+// vertex shader morphs each LOD into the next towards the end of its range
+// so switching LODs never pops.
+//
+// Positions are in the terrain's model space: cell (x, y) of an n x n map
+// sits at (2x/(n-1) - 1, 1 - 2y/(n-1)), as in Terrain.
+class CdlodQuadtree
+{
+public:
+    CdlodQuadtree();
+
+    // Compute the min/max elevation of every node of map. patchSize is the
+    // quads per side of the patch grid, a power of two no larger than the map.
+    void Build(const HeightField& map, int patchSize, unsigned int threadCount = 0);
+    void Clear();
+    inline bool IsEmpty() const { return mLevels.empty(); }
+
+    // Distance from the camera up to which the full resolution is used.
+    // Every coarser LOD reaches twice as far as the one before it.
+    void SetLodRanges(float finestRange);
+    // finestRange at which one full resolution quad spans about
+    // pixelsPerQuad pixels, fovY in degrees
+    float GetFinestRangeFor(float pixelsPerQuad, float viewportHeight, float fovY) const;
+
+    // Nodes to draw for a camera at eye, both in model space. Nodes outside
+    // the frustum are skipped.
+    void Select(const vmath::vec3& eye, const Frustum& frustum, CdlodSelection& selection) const;
+
+    inline int GetPatchSize() const { return mPatchSize; }
+    inline int GetLodCount() const { return (int)mLevels.size(); }
+    // Bytes held by the min/max pyramid
+    size_t GetSizeInBytes() const;
+
+private:
+    struct Level
+    {
+        int nodesPerSide;
+        std::vector<ElevationBounds> bounds;    // Row major, nodesPerSide^2
+    };
+
+    int mGridSize;              // Heightmap vertices per side
+    int mPatchSize;
+    float mSpacing;             // Model space distance between vertices
+    std::vector<Level> mLevels; // mLevels[lod], lod 0 has the smallest nodes
+    std::vector<float> mRanges; // Selection distance of each LOD
+
+    // Model space box of node (x, y) of a level
+    void GetBox(int lod, int x, int y, vmath::vec3& boxMin, vmath::vec3& boxMax) const;
+    // False when the node is out of its LOD's range, so its parent has to
+    // draw that area
+    bool SelectNode(int lod, int x, int y, const vmath::vec3& eye, const Frustum& frustum, CdlodSelection& selection) const;
+    CdlodNode MakeNode(int lod, float x, float y, float size) const;
+};
+
+#endif//__CDLOD_QUADTREE__
\ No newline at end of file
@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2018 Brendan Barnes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __DIAMOND_SQUARE__
+#define __DIAMOND_SQUARE__
+
+#include "HeightField.h"
+#include "DiamondSquareKernels.h"
+#include <atomic>
+#include <functional>
+
+// Diamond-square heightmap generator
+// https://en.wikipedia.org/wiki/Diamond-square_algorithm
+// Within one pass every diamond centre, and then every square midpoint, is
+// independent of the others, so each pass is split into row bands that run
+// on the shared ThreadPool with a barrier between the two steps.
+class DiamondSquare
+{
+public:
+    // Called with the map and the sideLength of a level just finished
+    typedef std::function<void(const HeightField& map, int sideLength)> LevelCallback;
+
+    DiamondSquare();
+
+    // Threads used per pass, 0 uses every hardware thread
+    inline void SetThreadCount(unsigned int threadCount) { mThreadCount = threadCount; }
+    inline unsigned int GetThreadCount() const { return mThreadCount; }
+
+    // Instruction set for the row kernels, defaults to the best the CPU
+    // supports. Every level gives the same heightmap.
+    inline void SetSimdLevel(SimdLevel level) { mSimdLevel = level; }
+    inline SimdLevel GetSimdLevel() const { return mSimdLevel; }
+
+    // Maps of at least blockingDetailLevel levels generate every pass with
+    // sideLength <= BLOCKED_SIDE_LENGTH tile by tile, so each cache sized
+    // tile stays resident across those passes. tileSize must be a power of
+    // two no smaller than BLOCKED_SIDE_LENGTH, 0 disables blocking.
+    inline void SetCacheBlocking(int tileSize, unsigned char blockingDetailLevel)
+    {
+        mTileSize = tileSize;
+        mBlockingDetailLevel = blockingDetailLevel;
+    }
+
+    // Optional fraction of the heightmap finished, updated as Generate runs
+    // so another thread can poll it. nullptr turns reporting off.
+    inline void SetProgress(std::atomic<float>* progress) { mProgress = progress; }
+
+    // Optional callback run on the generating thread after each level that
+    // is swept over the whole map. Every cell on a grid of sideLength/2 is
+    // final by then, so the map holds a complete coarser terrain. Levels
+    // generated tile by tile are not reported.
+    inline void SetLevelCallback(const LevelCallback& callback) { mLevelCallback = callback; }
+
+    // Fill map with a (2^detailLevel + 1)^2 DEM. The output only depends on
+    // detailLevel, range and seed, never on the thread count.
+    void Generate(HeightField& map, unsigned char detailLevel, float range, uint32_t seed);
+    // Fill the interior of map, a (2^detailLevel + 1)^2 DEM whose border
+    // rows and columns are already set, e.g. to edges shared with a
+    // neighbouring chunk. The map does not wrap and the border is left as
+    // is. Neither cache blocking nor the level callback apply.
+    void GenerateInterior(HeightField& map, unsigned char detailLevel, float range, uint32_t seed);
+
+    inline float GetMinElevation() const { return mMinElevation; }
+    inline float GetMaxElevation() const { return mMaxElevation; }
+
+private:
+    static const int BLOCKED_SIDE_LENGTH = 16;
+
+    unsigned int mThreadCount;
+    SimdLevel mSimdLevel;
+    int mTileSize;
+    unsigned char mBlockingDetailLevel;
+    float mMinElevation;
+    float mMaxElevation;
+    std::atomic<float>* mProgress;
+    LevelCallback mLevelCallback;
+
+    // Rows are given as indices into the rows touched by the step
+    static void DiamondRows(const DiamondSquareKernels& kernels, HeightField& map, int sideLength, float range,
+        uint32_t levelKey, int first, int last, float& minElevation, float& maxElevation);
+    static void SquareRows(const DiamondSquareKernels& kernels, HeightField& map, int sideLength, float range,
+        uint32_t levelKey, int first, int last, float& minElevation, float& maxElevation);
+    // Square step of GenerateInterior, rows are indices past the first row
+    static void InteriorSquareRows(const DiamondSquareKernels& kernels, HeightField& map, int sideLength, float range,
+        uint32_t levelKey, int first, int last, float& minElevation, float& maxElevation);
+
+    inline void ReportProgress(float fraction)
+    {
+        if(mProgress != nullptr)
+        {
+            mProgress->store(fraction, std::memory_order_relaxed);
+        }
+    }
+    // For threads finishing out of order: only ever moves the fraction up
+    inline void RaiseProgress(float fraction)
+    {
+        if(mProgress != nullptr)
+        {
+            float current = mProgress->load(std::memory_order_relaxed);
+            while(current < fraction && !mProgress->compare_exchange_weak(current, fraction, std::memory_order_relaxed))
+            {
+            }
+        }
+    }
+
+    // Passes from BLOCKED_SIDE_LENGTH down, one tile at a time
+    void GenerateTiles(const DiamondSquareKernels& kernels, HeightField& map, float range, uint32_t seed);
+    void GenerateTile(const DiamondSquareKernels& kernels, HeightField& map, HeightField& window,
+        int tileX, int tileY, float range, uint32_t seed, float& minElevation, float& maxElevation);
+};
+
+#endif//__DIAMOND_SQUARE__
@@ -0,0 +1,69 @@
+/*
+ * Copyright (c) 2018 Brendan Barnes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __DIAMOND_SQUARE_KERNELS__
+#define __DIAMOND_SQUARE_KERNELS__
+
+#include "Random.h"
+#include "Simd.h"
+
+// Row kernels for the diamond-square generator. Each kernel handles count
+// cells of one row at x = x0, x0 + sideLength, ... and widens its running
+// min/max elevation. Cell x draws its random offset from column
+// x + keyOffset, which lets a kernel run on a window into the map. The SIMD
+// versions evaluate exactly the same float expressions as the scalar cells
+// below, so every instruction set produces a bit-identical heightmap.
+
+// Diamond centre from the four corners of its square
+inline float DiamondCell(float topLeft, float topRight, float bottomLeft, float bottomRight, float offset)
+{
+    float avg = topLeft + topRight + bottomLeft + bottomRight;
+    avg *= 0.25f;
+    return avg + offset;
+}
+
+// Square midpoint from its four diamond neighbours
+inline float SquareCell(float up, float down, float right, float left, float offset)
+{
+    float sum = up + down + right + left;
+    return sum / (4.0f + offset);
+}
+
+// top/bottom are the corner rows and center the row being written
+typedef void (*DiamondRowKernel)(const float* top, const float* bottom, float* center,
+    int x0, int count, int sideLength, uint32_t rowKey, int keyOffset, float range, float& lo, float& hi);
+// up/down are the neighbouring rows, row is read for left/right and written.
+// Cells must not wrap around the left edge (x0 >= sideLength/2).
+typedef void (*SquareRowKernel)(const float* up, const float* down, float* row,
+    int x0, int count, int sideLength, uint32_t rowKey, int keyOffset, float range, float& lo, float& hi);
+
+struct DiamondSquareKernels
+{
+    DiamondRowKernel Diamond;
+    SquareRowKernel Square;
+};
+
+// Kernels for level, falling back to the best supported level below it
+const DiamondSquareKernels& GetDiamondSquareKernels(SimdLevel level);
+
+#endif//__DIAMOND_SQUARE_KERNELS__
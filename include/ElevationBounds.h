@@ -0,0 +1,41 @@
+/*
+ * Copyright (c) 2018 Brendan Barnes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#ifndef __ELEVATION_BOUNDS__
+#define __ELEVATION_BOUNDS__
+
+#include "HeightField.h"
+#include <vector>
+
+struct ElevationBounds
+{
+    float minElevation;
+    float maxElevation;
+};
+
+// Elevation range of every tileSize x tileSize quad tile of map, row major
+// with (width - 1)/tileSize tiles per side. Tiles include their edge
+// vertices, so neighbours share them. Rows of tiles run on the shared
+// ThreadPool, threadCount 0 uses every hardware thread.
+void ComputeTileBounds(const HeightField& map, int tileSize, std::vector<ElevationBounds>& bounds, unsigned int threadCount = 0);
+
+#endif//__ELEVATION_BOUNDS__
\ No newline at end of file
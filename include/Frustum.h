@@ -0,0 +1,81 @@
+/*
+ * Copyright (c) 2018 Brendan Barnes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#ifndef __FRUSTUM__
+#define __FRUSTUM__
+
+#include "vmath.h"
+
+// View volume as six planes, taken from a model-view-projection matrix so
+// the planes are in model space. Each plane is (a, b, c, d) with the inside
+// where a*x + b*y + c*z + d >= 0.
+class Frustum
+{
+public:
+    Frustum()
+    {
+        // Everything is inside until Set is called
+        for(int i = 0; i < 6; i++)
+        {
+            mPlanes[i] = vmath::vec4(0.0f, 0.0f, 0.0f, 1.0f);
+        }
+    }
+    explicit Frustum(const vmath::mat4& mvp) { Set(mvp); }
+
+    // Gribb/Hartmann extraction. vmath matrices are column major, so
+    // mvp[c][r] is row r of column c.
+    void Set(const vmath::mat4& mvp)
+    {
+        for(int i = 0; i < 3; i++)
+        {
+            for(int k = 0; k < 4; k++)
+            {
+                mPlanes[2*i][k] = mvp[k][3] + mvp[k][i];
+                mPlanes[2*i+1][k] = mvp[k][3] - mvp[k][i];
+            }
+        }
+    }
+
+    // False when the axis aligned box lies entirely outside one plane. Boxes
+    // near a corner of the frustum may pass without being visible.
+    bool Intersects(const vmath::vec3& boxMin, const vmath::vec3& boxMax) const
+    {
+        for(int i = 0; i < 6; i++)
+        {
+            const vmath::vec4& p = mPlanes[i];
+            // Corner farthest along the plane normal
+            float x = p[0] >= 0.0f ? boxMax[0] : boxMin[0];
+            float y = p[1] >= 0.0f ? boxMax[1] : boxMin[1];
+            float z = p[2] >= 0.0f ? boxMax[2] : boxMin[2];
+            if(p[0]*x + p[1]*y + p[2]*z + p[3] < 0.0f)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    vmath::vec4 mPlanes[6];     // Left, right, bottom, top, near, far
+};
+
+#endif//__FRUSTUM__
\ No newline at end of file
@@ -27,30 +27,49 @@
 #define GLEW_STATIC
 
 #include "GL/glew.h"
+// With TERRAIN_HEADLESS defined only the offscreen EGL path is built, so
+// nothing needs GLFW or X11 at link time. The header still supplies the key
+// codes and GLFWwindow, which are declarations only.
 #include "GLFW/glfw3.h"
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#include <chrono>
+#include <cstdio>
 #include <iostream>
 #include <string.h>
+#include <vector>
 #include <vmath.h>
 #include "Shader.h"
 
 class Game
 {
 public:
-    Game() {}
+    Game() : window(NULL), eglDisplay(EGL_NO_DISPLAY), eglContext(EGL_NO_CONTEXT), eglSurface(EGL_NO_SURFACE),
+        framebuffer(0), colorBuffer(0), depthBuffer(0) {}
     virtual ~Game() {}
     void run(Game* the_game)
     {
         game = the_game;
+
+        init();
+
+#ifdef TERRAIN_HEADLESS
+        runHeadless();
+#else
         bool running = true;
 
+        if (info.flags.headless)
+        {
+            runHeadless();
+            return;
+        }
+
         if (!glfwInit())
         {
             std::cout << "Failed to initialize GLFW!" << std::endl;
             return;
         }
 
-        init();
-
         glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, info.majorVersion);
         glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, info.minorVersion);
 
@@ -101,7 +120,7 @@ public:
 
         glfwDestroyWindow(window);
         glfwTerminate();
-
+#endif
     }
 
     virtual void init()
@@ -114,6 +133,8 @@ public:
         info.samples = 0;
         info.flags.all = 0;
         info.flags.cursor = 1;
+        info.frames = 1;
+        info.output[0] = '\0';
     }
 
     virtual void startup()
@@ -133,7 +154,38 @@ public:
 
     void setWindowTitle(const char * title)
     {
-        glfwSetWindowTitle(window, title);
+#ifndef TERRAIN_HEADLESS
+        if (window)
+        {
+            glfwSetWindowTitle(window, title);
+        }
+#endif
+    }
+
+    // Write the colour buffer being drawn to as a binary PPM
+    bool saveFrame(const char* path)
+    {
+        int width = info.windowWidth;
+        int height = info.windowHeight;
+        std::vector<unsigned char> pixels((size_t)width*height*3);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+        glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+        FILE* file = fopen(path, "wb");
+        if (!file)
+        {
+            std::cout << "Failed to open " << path << "!" << std::endl;
+            return false;
+        }
+        fprintf(file, "P6\n%d %d\n255\n", width, height);
+        // GL rows start at the bottom
+        for (int y = height - 1; y >= 0; y--)
+        {
+            fwrite(&pixels[(size_t)y*width*3], 1, (size_t)width*3, file);
+        }
+        fclose(file);
+        return true;
     }
 
     virtual void onResize(int w, int h)
@@ -164,8 +216,13 @@ public:
 
     void getMousePosition(int& x, int& y)
     {
-        double dx, dy;
-        glfwGetCursorPos(window, &dx, &dy);
+        double dx = 0.0, dy = 0.0;
+#ifndef TERRAIN_HEADLESS
+        if (window)
+        {
+            glfwGetCursorPos(window, &dx, &dy);
+        }
+#endif
 
         x = static_cast<int>(floor(dx));
         y = static_cast<int>(floor(dy));
@@ -186,9 +243,12 @@ public:
                 unsigned int    fullscreen  : 1;
                 unsigned int    vsync       : 1;
                 unsigned int    cursor      : 1;
+                unsigned int    headless    : 1;    // No window, render offscreen
             };
             unsigned int        all;
         } flags;
+        int frames;             // Frames rendered when headless
+        char output[256];       // PPM the last headless frame is saved to, empty for none
     };
 
 protected:
@@ -196,6 +256,155 @@ protected:
     GLFWwindow* window;
     GameInfo info;
 
+    // Headless mode
+    EGLDisplay eglDisplay;
+    EGLContext eglContext;
+    EGLSurface eglSurface;  // 1x1 pbuffer when surfaceless contexts are not supported
+    GLuint framebuffer;
+    GLuint colorBuffer;
+    GLuint depthBuffer;
+
+    // Render info.frames frames into a framebuffer object without a window
+    // or display server, e.g. on Mesa's software rasteriser in a container.
+    // Frames are a 60th of a second apart whatever they take, so runs are
+    // repeatable. Input callbacks are never called.
+    void runHeadless()
+    {
+        if (!createHeadlessContext())
+        {
+            std::cout << "Failed to create a headless OpenGL context!" << std::endl;
+            destroyHeadlessContext();
+            return;
+        }
+
+        // Single sampled, info.samples only applies to windows
+        glGenFramebuffers(1, &framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glGenRenderbuffers(1, &colorBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, info.windowWidth, info.windowHeight);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+        glGenRenderbuffers(1, &depthBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, info.windowWidth, info.windowHeight);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        {
+            std::cout << "Headless framebuffer is incomplete!" << std::endl;
+            destroyHeadlessContext();
+            return;
+        }
+        glViewport(0, 0, info.windowWidth, info.windowHeight);
+
+        startup();
+
+        int frames = info.frames > 0 ? info.frames : 1;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for (int frame = 0; frame < frames; frame++)
+        {
+            render(frame/60.0);
+        }
+        glFinish();
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << "Rendered " << frames << " frames in " << elapsed.count() << " ms ("
+            << elapsed.count()/frames << " ms per frame) on " << glGetString(GL_RENDERER) << std::endl;
+
+        if (info.output[0] != '\0' && saveFrame(info.output))
+        {
+            std::cout << "Saved the last frame to " << info.output << std::endl;
+        }
+
+        shutdown();
+
+        destroyHeadlessContext();
+    }
+
+    bool createHeadlessContext()
+    {
+        // Mesa's surfaceless platform needs no display server at all. Other
+        // drivers get the default display and, without
+        // EGL_KHR_surfaceless_context, a pbuffer to make current.
+        PFNEGLGETPLATFORMDISPLAYEXTPROC getPlatformDisplay =
+            (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        eglDisplay = getPlatformDisplay ? getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL) : EGL_NO_DISPLAY;
+        if (eglDisplay == EGL_NO_DISPLAY || !eglInitialize(eglDisplay, NULL, NULL))
+        {
+            eglDisplay = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+            if (eglDisplay == EGL_NO_DISPLAY || !eglInitialize(eglDisplay, NULL, NULL))
+            {
+                eglDisplay = EGL_NO_DISPLAY;
+                return false;
+            }
+        }
+        if (!eglBindAPI(EGL_OPENGL_API))
+        {
+            return false;
+        }
+
+        const EGLint configAttributes[] = {
+            EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+            EGL_NONE
+        };
+        EGLConfig config = NULL;
+        EGLint configCount = 0;
+        eglChooseConfig(eglDisplay, configAttributes, &config, 1, &configCount);
+        const EGLint contextAttributes[] = {
+            EGL_CONTEXT_MAJOR_VERSION, info.majorVersion,
+            EGL_CONTEXT_MINOR_VERSION, info.minorVersion,
+            EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+            EGL_NONE
+        };
+        eglContext = eglCreateContext(eglDisplay, configCount > 0 ? config : EGL_NO_CONFIG_KHR, EGL_NO_CONTEXT, contextAttributes);
+        if (eglContext == EGL_NO_CONTEXT)
+        {
+            return false;
+        }
+        if (!eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, eglContext))
+        {
+            const EGLint surfaceAttributes[] = { EGL_WIDTH, 1, EGL_HEIGHT, 1, EGL_NONE };
+            eglSurface = configCount > 0 ? eglCreatePbufferSurface(eglDisplay, config, surfaceAttributes) : EGL_NO_SURFACE;
+            if (eglSurface == EGL_NO_SURFACE || !eglMakeCurrent(eglDisplay, eglSurface, eglSurface, eglContext))
+            {
+                return false;
+            }
+        }
+
+        // GLEW also looks for a GLX display, which a headless context lacks.
+        // The core entry points are loaded before that check.
+        glewExperimental = GL_TRUE;
+        glewInit();
+        return glGenFramebuffers != NULL;
+    }
+
+    void destroyHeadlessContext()
+    {
+        if (eglContext != EGL_NO_CONTEXT && framebuffer != 0)
+        {
+            glDeleteRenderbuffers(1, &depthBuffer);
+            glDeleteRenderbuffers(1, &colorBuffer);
+            glDeleteFramebuffers(1, &framebuffer);
+        }
+        framebuffer = colorBuffer = depthBuffer = 0;
+        if (eglDisplay != EGL_NO_DISPLAY)
+        {
+            eglMakeCurrent(eglDisplay, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+            if (eglSurface != EGL_NO_SURFACE)
+            {
+                eglDestroySurface(eglDisplay, eglSurface);
+            }
+            if (eglContext != EGL_NO_CONTEXT)
+            {
+                eglDestroyContext(eglDisplay, eglContext);
+            }
+            eglTerminate(eglDisplay);
+        }
+        eglDisplay = EGL_NO_DISPLAY;
+        eglContext = EGL_NO_CONTEXT;
+        eglSurface = EGL_NO_SURFACE;
+    }
+
+#ifndef TERRAIN_HEADLESS
     static void glfw_onResize(GLFWwindow* window, int w, int h)
     {
         game->onResize(w, h);
@@ -220,6 +429,7 @@ protected:
     {
         game->onMouseWheel(static_cast<int>(yoffset));
     }
+#endif
 
 };
 
@@ -0,0 +1,118 @@
+/*
+ * Copyright (c) 2018 Brendan Barnes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __GEOMETRY_CLIPMAP__
+#define __GEOMETRY_CLIPMAP__
+
+#include "Mesh.h"
+#include "GridIndexCache.h"
+#include "Texture.h"
+#include <memory>
+#include <vector>
+
+struct ClipmapStats
+{
+    size_t uploadedTexels;      // By the last Update
+    size_t totalUploadedTexels; // Since the clipmap was created
+    int refilledLevels;         // Levels uploaded whole since creation
+    size_t triangles;           // Drawn by the last Render
+    size_t gpuBytes;            // Height textures
+};
+
+// Unbounded terrain drawn as a geometry clipmap (Losasso and Hoppe, "Geometry
+// Clipmaps", 2004). Level l is a gridSize^2 vertex grid with 2^l times the
+// finest spacing, centred on the camera, and each level but the finest
+// leaves a hole where the next finer one sits. The outer band of every
+// level morphs into the surface of the coarser level, so they meet
+// without cracks.
+//
+// Heights are fractal value noise, a pure function of the world cell, and
+// each level leaves out octaves finer than its own spacing. Every level
+// keeps its heights in a (gridSize + 2)^2 texture addressed toroidally:
+// world cell (x, y) lives in texel (x mod size, y mod size). When the
+// camera moves, only the rows and columns it uncovers are generated and
+// written with glTexSubImage2D, so the upload per frame follows the
+// camera's speed and not the size of the world.
+//
+// Drawn with res/shaders/clipmap.glsl. World cell (x, y) of the finest
+// level sits at (x*spacing, -y*spacing), rows grow towards -y as in Terrain.
+class GeometryClipmap
+{
+public:
+    // gridSize is 2^k + 1 with k >= 3
+    GeometryClipmap(int levelCount, int gridSize, float spacing, float range, unsigned int seed);
+
+    // Call once per frame on the render thread with the camera's world x/y
+    void Update(float cameraX, float cameraY);
+    // Draws every level, finest first
+    void Render(Shader* shader);
+    // Free the GL resources while the context is still alive
+    void Release();
+
+    // Height of finest world cell (x, y) as level `level` stores it, without
+    // the octaves finer than twice that level's spacing. Thread safe.
+    static float SampleHeight(unsigned int seed, float range, int x, int y, int level);
+
+    // Threads used to fill uncovered texels, 0 uses every hardware thread
+    inline void SetThreadCount(unsigned int threadCount) { mThreadCount = threadCount; }
+    inline int GetLevelCount() const { return (int)mLevels.size(); }
+    inline int GetGridSize() const { return mGridSize; }
+    // Elevation range of every texel uploaded so far, only ever widens
+    inline float GetMinElevation() const { return mMinElevation; }
+    inline float GetMaxElevation() const { return mMaxElevation; }
+    inline const ClipmapStats& GetStats() const { return mStats; }
+
+private:
+    struct Level
+    {
+        int originX;        // Level cell of the grid's first vertex, always even
+        int originY;
+        bool resident;      // Texture holds the window around the origin
+        Texture texture;    // RG32F, this level's height and the coarser level's surface
+    };
+
+    const int mGridSize;
+    const int mTextureSize;     // mGridSize plus a texel on each side for normals
+    const float mSpacing;
+    const float mRange;
+    const unsigned int mSeed;
+    unsigned int mThreadCount;
+    float mMinElevation;
+    float mMaxElevation;
+    std::vector<Level> mLevels;
+
+    Mesh mMesh;                 // Vertex array, positions come from gl_VertexID
+    std::shared_ptr<GridIndices> mFullIndices;  // Finest level
+    IndexBuffer mRingIndices[4];    // Coarser levels, by where the finer level's hole sits
+    std::vector<float> mStaging;    // Texels of the region being filled
+    ClipmapStats mStats;
+
+    // Hole offsets of level `level`, q or q + 1 cells on each axis where
+    // q = (gridSize - 1)/4
+    void GetHoleOffset(int level, int& holeX, int& holeY) const;
+    void BuildRingIndices();
+    // Generate and upload the texels of level cells [x0, x0 + width) x [y0, y0 + height)
+    void FillRegion(int level, int x0, int y0, int width, int height);
+};
+
+#endif//__GEOMETRY_CLIPMAP__
\ No newline at end of file
@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2018 Brendan Barnes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __GRID_INDEX_CACHE__
+#define __GRID_INDEX_CACHE__
+
+#include "GridLayout.h"
+#include "IndexBuffer.h"
+#include <map>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Triangle indices of an n x n vertex grid, kept on the CPU and in GL.
+// Indices are ordered chunk by chunk, so any chunk, or a run of chunks in
+// the same chunk row, can be drawn as one range of the buffer.
+struct GridIndices
+{
+    int gridSize;
+    IndexLayout layout;
+    GLenum primitive;   // Primitive type to draw the indices with
+    int chunkSize;      // Quads per chunk side
+    int chunksPerSide;
+    size_t chunkIndexCount;     // Indices of every chunk, chunk k starts at k*chunkIndexCount
+    std::vector<unsigned int> indices;
+    IndexBuffer buffer;
+};
+
+// Process-wide cache of grid index buffers. The indices of a grid only
+// depend on its size and layout, so every terrain of one size shares a
+// single copy. Entries are reference counted and freed with their last holder.
+class GridIndexCache
+{
+public:
+    // Shared indices for an n x n grid, built and uploaded on first use.
+    // Must be called with the GL context current.
+    static std::shared_ptr<GridIndices> Acquire(int gridSize, IndexLayout layout = IndexLayout::TRIANGLE_LIST);
+    // Build the CPU indices of an entry without touching GL, so a worker
+    // thread can do it ahead of Acquire. The entry lives while it is held.
+    static std::shared_ptr<GridIndices> Prepare(int gridSize, IndexLayout layout = IndexLayout::TRIANGLE_LIST);
+
+    static GLenum GetPrimitiveType(IndexLayout layout);
+
+private:
+    typedef std::pair<int, IndexLayout> Key;
+
+    // Finds or builds the entry, sMutex must be held
+    static std::shared_ptr<GridIndices> FindOrBuild(int gridSize, IndexLayout layout);
+
+    static std::mutex sMutex;
+    static std::map<Key, std::weak_ptr<GridIndices>> sEntries;
+};
+
+#endif//__GRID_INDEX_CACHE__
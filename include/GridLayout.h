@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2018 Brendan Barnes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __GRID_LAYOUT__
+#define __GRID_LAYOUT__
+
+#include <cstddef>
+
+// How the quads of a vertex grid are turned into triangles
+enum class IndexLayout
+{
+    TRIANGLE_LIST = 0,  // 6 indices per quad, drawn as GL_TRIANGLES
+    TRIANGLE_STRIP = 1  // One strip per row, split by the primitive restart index
+};
+
+// Restart index for GL_UNSIGNED_INT under GL_PRIMITIVE_RESTART_FIXED_INDEX
+const unsigned int GRID_RESTART_INDEX = 0xFFFFFFFFu;
+// Quads per side of the chunks a grid's indices are grouped into
+const int GRID_CHUNK_SIZE = 64;
+
+// Triangle indices of an n x n vertex grid, without any GL. Indices are
+// ordered chunk by chunk, so any chunk, or a run of chunks in the same
+// chunk row, is one range of the buffer.
+
+// Lists take 6 indices per quad. Strips take 2(c+1) per row of quads of
+// a chunk of c quads plus one restart index, about a third as many.
+size_t GetGridIndexCount(int gridSize, IndexLayout layout);
+// Chunks are GRID_CHUNK_SIZE quads, or the whole grid when it is smaller
+// or not a multiple of it
+int GetGridChunkSize(int gridSize);
+size_t GetGridChunkIndexCount(int chunkSize, IndexLayout layout);
+// Writes GetGridIndexCount(gridSize, layout) indices
+void BuildGridIndices(int gridSize, IndexLayout layout, unsigned int* indices);
+
+#endif//__GRID_LAYOUT__
\ No newline at end of file
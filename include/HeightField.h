@@ -0,0 +1,209 @@
+/*
+ * Copyright (c) 2018 Brendan Barnes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __HEIGHT_FIELD__
+#define __HEIGHT_FIELD__
+
+#include <cstddef>
+#include <cstdlib>
+#include <stdint.h>
+#include <new>
+
+// Non-owning window into a pitched height buffer. (x, y) is (column, row).
+template <typename T>
+class HeightFieldView
+{
+public:
+    HeightFieldView()
+        : mData(nullptr), mWidth(0), mHeight(0), mPitch(0) {}
+    HeightFieldView(T* data, int width, int height, int pitch)
+        : mData(data), mWidth(width), mHeight(height), mPitch(pitch) {}
+
+    inline T& operator()(int x, int y) const { return mData[(size_t)y*mPitch + x]; }
+    inline T* Row(int y) const { return mData + (size_t)y*mPitch; }
+    inline T* GetData() const { return mData; }
+    inline int GetWidth() const { return mWidth; }
+    inline int GetHeight() const { return mHeight; }
+    inline int GetPitch() const { return mPitch; }
+
+    // Window of width x height elements whose top left corner is (x, y)
+    HeightFieldView SubRect(int x, int y, int width, int height) const
+    {
+        return HeightFieldView(mData + (size_t)y*mPitch + x, width, height, mPitch);
+    }
+
+    operator HeightFieldView<const T>() const
+    {
+        return HeightFieldView<const T>(mData, mWidth, mHeight, mPitch);
+    }
+
+private:
+    T* mData;
+    int mWidth;
+    int mHeight;
+    int mPitch;     // Elements between the starts of consecutive rows
+};
+
+// Owning, move-only height buffer. All rows live in one allocation aligned
+// to a cache line and every row starts on a cache line boundary.
+template <typename T>
+class BasicHeightField
+{
+public:
+    static const size_t ALIGNMENT = 64;
+
+    BasicHeightField()
+        : mData(nullptr), mWidth(0), mHeight(0), mPitch(0), mCapacity(0) {}
+
+    BasicHeightField(int width, int height)
+        : mData(nullptr), mWidth(0), mHeight(0), mPitch(0), mCapacity(0)
+    {
+        Allocate(width, height);
+    }
+
+    ~BasicHeightField()
+    {
+        free(mData);
+    }
+
+    BasicHeightField(BasicHeightField&& other)
+        : mData(other.mData), mWidth(other.mWidth), mHeight(other.mHeight),
+          mPitch(other.mPitch), mCapacity(other.mCapacity)
+    {
+        other.mData = nullptr;
+        other.mWidth = other.mHeight = other.mPitch = 0;
+        other.mCapacity = 0;
+    }
+
+    BasicHeightField& operator=(BasicHeightField&& other)
+    {
+        if(this != &other)
+        {
+            free(mData);
+            mData = other.mData;
+            mWidth = other.mWidth;
+            mHeight = other.mHeight;
+            mPitch = other.mPitch;
+            mCapacity = other.mCapacity;
+            other.mData = nullptr;
+            other.mWidth = other.mHeight = other.mPitch = 0;
+            other.mCapacity = 0;
+        }
+        return *this;
+    }
+
+    BasicHeightField(const BasicHeightField&) = delete;
+    BasicHeightField& operator=(const BasicHeightField&) = delete;
+
+    // Resize to width x height. The existing buffer is kept when it is
+    // already large enough, so regenerating at the same size never allocates.
+    void Allocate(int width, int height)
+    {
+        const int pitch = GetPitchFor(width);
+        const size_t bytes = (size_t)pitch*height*sizeof(T);
+        if(bytes > mCapacity)
+        {
+            free(mData);
+            mData = nullptr;
+            mCapacity = 0;
+            void* memory = nullptr;
+            if(posix_memalign(&memory, ALIGNMENT, bytes) != 0)
+            {
+                throw std::bad_alloc();
+            }
+            mData = static_cast<T*>(memory);
+            mCapacity = bytes;
+        }
+        mWidth = width;
+        mHeight = height;
+        mPitch = pitch;
+    }
+
+    // Pitch and bytes Allocate would use for width x height
+    static int GetPitchFor(int width)
+    {
+        const int perLine = ALIGNMENT/sizeof(T);
+        return (width + perLine - 1)/perLine*perLine;
+    }
+    static size_t GetSizeInBytesFor(int width, int height)
+    {
+        return (size_t)GetPitchFor(width)*height*sizeof(T);
+    }
+
+    void Fill(T value)
+    {
+        for(int y = 0; y < mHeight; y++)
+        {
+            T* row = Row(y);
+            for(int x = 0; x < mWidth; x++)
+            {
+                row[x] = value;
+            }
+        }
+    }
+
+    inline T& operator()(int x, int y) { return mData[(size_t)y*mPitch + x]; }
+    inline const T& operator()(int x, int y) const { return mData[(size_t)y*mPitch + x]; }
+    inline T* Row(int y) { return mData + (size_t)y*mPitch; }
+    inline const T* Row(int y) const { return mData + (size_t)y*mPitch; }
+    inline T* GetData() { return mData; }
+    inline const T* GetData() const { return mData; }
+    inline int GetWidth() const { return mWidth; }
+    inline int GetHeight() const { return mHeight; }
+    inline int GetPitch() const { return mPitch; }
+    inline size_t GetSizeInBytes() const { return (size_t)mPitch*mHeight*sizeof(T); }
+
+    HeightFieldView<T> GetView()
+    {
+        return HeightFieldView<T>(mData, mWidth, mHeight, mPitch);
+    }
+    HeightFieldView<const T> GetView() const
+    {
+        return HeightFieldView<const T>(mData, mWidth, mHeight, mPitch);
+    }
+    operator HeightFieldView<const T>() const
+    {
+        return GetView();
+    }
+    HeightFieldView<T> SubRect(int x, int y, int width, int height)
+    {
+        return GetView().SubRect(x, y, width, height);
+    }
+    HeightFieldView<const T> SubRect(int x, int y, int width, int height) const
+    {
+        return GetView().SubRect(x, y, width, height);
+    }
+
+private:
+    T* mData;
+    int mWidth;
+    int mHeight;
+    int mPitch;         // Elements between the starts of consecutive rows
+    size_t mCapacity;   // Bytes owned by mData
+};
+
+typedef BasicHeightField<float> HeightField;
+// Heights as fractions of an elevation range, see HeightQuantizer.h
+typedef BasicHeightField<uint16_t> QuantizedHeightField;
+
+#endif//__HEIGHT_FIELD__
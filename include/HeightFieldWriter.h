@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2018 Brendan Barnes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __HEIGHT_FIELD_WRITER__
+#define __HEIGHT_FIELD_WRITER__
+
+#include "HeightField.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <future>
+#include <string>
+
+// File formats a heightmap can be exported to
+enum class HeightFileFormat
+{
+    RAW_FLOAT32 = 0,    // Little-endian float32 rows, plus <path>.json with the size and range
+    PNG16 = 1,          // 16-bit greyscale, min to maxElevation scaled to 0-65535
+    ENVI_BIL = 2        // float32 band interleaved by line, plus an ENVI header beside it
+};
+
+// Streams a heightmap to disk without a full-size copy. Rows are converted
+// band by band into two aligned buffers in turn. Whenever one fills it goes
+// out with a single write() on a background thread while the next band is
+// converted into the other, so the disk stays busy.
+// With direct I/O the file is opened O_DIRECT, bypassing the page cache;
+// file systems that refuse it fall back to buffered writes.
+//
+// Meant to be kept and reused, the buffer is allocated once. Not thread
+// safe, use one writer per thread.
+class HeightFieldWriter
+{
+public:
+    HeightFieldWriter();
+    ~HeightFieldWriter();
+
+    HeightFieldWriter(const HeightFieldWriter&) = delete;
+    HeightFieldWriter& operator=(const HeightFieldWriter&) = delete;
+
+    // Bytes per write, rounded up to a multiple of the direct I/O block.
+    // Twice this is allocated.
+    void SetBufferSize(size_t bytes);
+    inline size_t GetBufferSize() const { return mBufferSize; }
+    inline void SetDirectIO(bool direct) { mDirectIO = direct; }
+
+    // Write map to path in format. The elevation range scales PNG heights
+    // and is recorded in the sidecar headers. Returns false and reports
+    // the error if any part of the file could not be written.
+    bool Write(const std::string& path, HeightFieldView<const float> map, HeightFileFormat format,
+        float minElevation, float maxElevation);
+
+    // Extension of the main file, without the dot
+    static const char* GetExtension(HeightFileFormat format);
+    // Bytes one height takes in the main file
+    static inline size_t GetBytesPerHeight(HeightFileFormat format)
+    {
+        return format == HeightFileFormat::PNG16 ? sizeof(uint16_t) : sizeof(float);
+    }
+    // "raw", "png" or "bil", false for anything else
+    static bool ParseFormat(const char* name, HeightFileFormat& format);
+
+private:
+    static const size_t BLOCK_SIZE = 4096;  // Alignment O_DIRECT needs
+
+    unsigned char* mBuffers;    // Both buffers, one after the other
+    unsigned char* mBuffer;     // The one being filled
+    size_t mBufferSize;
+    size_t mUsed;               // Bytes of mBuffer waiting to be written
+    std::future<bool> mPending; // Write of the other buffer
+    int mFile;
+    bool mDirectIO;
+    bool mDirect;       // mFile is open with O_DIRECT
+    bool mFailed;
+    std::string mPath;
+
+    bool Open(const std::string& path);
+    void Append(const void* data, size_t size);
+    // Start writing mBuffer in the background and switch to the other one
+    void Flush();
+    void WaitForWrite();
+    bool WriteBlock(const unsigned char* data, size_t size);
+    bool Close();
+
+    void WriteRows(HeightFieldView<const float> map);
+    void WritePng(HeightFieldView<const float> map, float minElevation, float maxElevation);
+    // Chunk with its length and CRC, the data is appended by the caller
+    void BeginPngChunk(const char* type, uint32_t length, uint32_t& crc);
+    void AppendPngData(const void* data, size_t size, uint32_t& crc);
+    void EndPngChunk(uint32_t crc);
+    bool WriteSidecar(const std::string& path, const std::string& text);
+};
+
+#endif//__HEIGHT_FIELD_WRITER__
\ No newline at end of file
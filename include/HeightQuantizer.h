@@ -0,0 +1,55 @@
+/*
+ * Copyright (c) 2018 Brendan Barnes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __HEIGHT_QUANTIZER__
+#define __HEIGHT_QUANTIZER__
+
+#include "HeightField.h"
+
+// Largest quantized height, which maps to the top of the elevation range.
+// Matches the scale GL applies to GL_R16 and normalized ushort data.
+const float QUANTIZED_HEIGHT_MAX = 65535.0f;
+
+// One height rounded to 16 bits, scale is QUANTIZED_HEIGHT_MAX over the range.
+// Clamped first, so the conversion truncates a non-negative value and no
+// floorf call is needed.
+inline uint16_t QuantizeHeight(float height, float minElevation, float scale)
+{
+    float q = (height - minElevation)*scale + 0.5f;
+    q = q < 0.0f ? 0.0f : (q > QUANTIZED_HEIGHT_MAX ? QUANTIZED_HEIGHT_MAX : q);
+    return (uint16_t)q;
+}
+
+inline float DequantizeHeight(uint16_t height, float minElevation, float maxElevation)
+{
+    return minElevation + ((float)height/QUANTIZED_HEIGHT_MAX)*(maxElevation - minElevation);
+}
+
+// Round every height of map to 16 bits relative to [minElevation, maxElevation],
+// resizing quantized to match. Rows are split over the shared ThreadPool.
+// Returns the largest absolute error of a dequantized height, which is at
+// most half a step of (maxElevation - minElevation)/65535 plus rounding.
+float QuantizeHeights(HeightFieldView<const float> map, float minElevation, float maxElevation,
+    QuantizedHeightField& quantized, unsigned int threadCount = 0);
+
+#endif//__HEIGHT_QUANTIZER__
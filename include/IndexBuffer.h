@@ -25,6 +25,7 @@
 #define __INDEX_BUFFER__
 
 #include "GLCall.h"
+#include "GpuMemory.h"
 
 class IndexBuffer
 {
@@ -32,14 +33,20 @@ public:
     IndexBuffer();
     ~IndexBuffer();
     
+    // Upload data, reusing the existing buffer object. Storage is only
+    // reallocated when the size changes; otherwise it is overwritten in place.
     void CreateBuffer(const unsigned int* indices, unsigned int count);
+    // Delete the buffer object and its storage
+    void Release();
     void Bind() const;
     inline GLuint GetID() { return mID; }
     inline GLuint GetCount() const { return mCount; }
+    inline size_t GetSize() const { return mSize; }
 
 private:
     GLuint mID;
     unsigned int mCount;
+    size_t mSize;       // Bytes of storage held
 };
 
 #endif//__VERTEX_BUFFER__
\ No newline at end of file
@@ -32,6 +32,7 @@
 
 #include "VertexBuffer.h"
 #include "IndexBuffer.h"
+#include "VertexLayout.h"
 #include "Shader.h"
 #include "vmath.h"
 #include <iostream>
@@ -43,17 +44,32 @@ private:
     IndexBuffer* mIboPtr;
     GLuint mVao;
 
+    // Point the attributes of layout at buffer, advancing every divisor instances
+    void BindAttributes(VertexBuffer *buffer, const VertexLayout& layout, unsigned int divisor);
+
 protected:
     VertexBuffer mVbo;
-    VertexBuffer mNbo;
     IndexBuffer mIbo;
 
 public:
     Mesh();
     ~Mesh();
+    // Three tightly packed floats at position
     void SetVerticies(VertexBuffer *vertexBuffer, unsigned int position);
+    // Every attribute of layout, interleaved in vertexBuffer
+    void SetVerticies(VertexBuffer *vertexBuffer, const VertexLayout& layout);
+    // Stop feeding an attribute, for meshes built in the vertex shader
+    void DisableVerticies(unsigned int position);
+    // Attributes of layout that advance once per instance instead of per vertex
+    void SetInstances(VertexBuffer *instanceBuffer, const VertexLayout& layout);
     void SetIndices(IndexBuffer *indexBuffer);
-    void Render(Shader* shader);
+    // Strips rely on GL_PRIMITIVE_RESTART_FIXED_INDEX being enabled
+    void Render(Shader* shader, GLenum primitive = GL_TRIANGLES);
+    // Draw rangeCount ranges of the index buffer, offsets are in bytes
+    void RenderRanges(Shader* shader, GLenum primitive, const GLsizei* counts, const void* const* offsets, GLsizei rangeCount);
+    // Draw instanceCount copies of the indexed mesh, the first reading
+    // instance attributes from element baseInstance
+    void RenderInstanced(Shader* shader, GLenum primitive, unsigned int instanceCount, unsigned int baseInstance = 0);
 
 };
 
@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2018 Brendan Barnes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __RANDOM__
+#define __RANDOM__
+
+#include <stdint.h>
+
+// Stateless, counter based random numbers for terrain generation.
+// Every value is a pure function of (seed, level, x, y), so cells can be
+// generated in any order, on any thread, and the same seed always gives the
+// same terrain. The hash only uses 32 bit integer operations so it maps
+// directly onto SIMD lanes.
+
+// 32 bit avalanche mixer (lowbias32 by Chris Wellons)
+inline uint32_t HashMix(uint32_t h)
+{
+    h ^= h >> 16;
+    h *= 0x7feb352dU;
+    h ^= h >> 15;
+    h *= 0x846ca68bU;
+    h ^= h >> 16;
+    return h;
+}
+
+// Key shared by every cell of one level
+inline uint32_t HashLevelKey(uint32_t seed, uint32_t level)
+{
+    return HashMix(HashMix(seed) + level*0x9e3779b9U);
+}
+
+// Key shared by every cell of one row of one level
+inline uint32_t HashRowKey(uint32_t levelKey, uint32_t y)
+{
+    return HashMix(levelKey ^ y);
+}
+
+inline uint32_t HashCell(uint32_t rowKey, uint32_t x)
+{
+    return HashMix(rowKey ^ x);
+}
+
+// Map the top 24 bits of a hash to a float in [fMin, fMax)
+inline float HashToRange(uint32_t h, float fMin, float fMax)
+{
+    float f = (float)(h >> 8) * (1.0f/16777216.0f);
+    return fMin + f * (fMax - fMin);
+}
+
+inline float RandomRange(uint32_t seed, uint32_t level, uint32_t x, uint32_t y, float fMin, float fMax)
+{
+    return HashToRange(HashCell(HashRowKey(HashLevelKey(seed, level), y), x), fMin, fMax);
+}
+
+#endif//__RANDOM__
@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2018 Brendan Barnes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __RING_BUFFER__
+#define __RING_BUFFER__
+
+#include "GLCall.h"
+#include "GpuMemory.h"
+#include <deque>
+
+struct RingBufferStats
+{
+    size_t reservations;
+    size_t wraps;               // Reservations that restarted at offset 0
+    size_t stalls;              // Reservations that had to wait for the GPU
+    double stallMilliseconds;   // Total time spent waiting
+};
+
+// Persistently mapped GL buffer handed out as a ring of spans. The CPU
+// writes straight into GPU visible memory, then commits the span with a
+// fence once the commands that read it have been issued. A span is only
+// handed out again after its fence has signalled. Needs GL 4.4 or
+// ARB_buffer_storage.
+class RingBuffer
+{
+public:
+    RingBuffer();
+    ~RingBuffer();
+
+    RingBuffer(const RingBuffer&) = delete;
+    RingBuffer& operator=(const RingBuffer&) = delete;
+
+    static bool IsSupported();
+
+    // Allocate and map size bytes, replacing any existing storage
+    void Create(size_t size);
+    void Release();
+
+    // Writable span of size bytes starting at a multiple of alignment.
+    // Waits for the GPU when the span is still in use. Returns nullptr when
+    // size is larger than the whole ring.
+    void* Reserve(size_t size, size_t alignment = 16);
+    // Fence the span from the last Reserve. Call after issuing every GL
+    // command that reads it.
+    void Commit();
+
+    inline GLuint GetID() const { return mID; }
+    inline size_t GetSize() const { return mSize; }
+    // Offset of the span from the last Reserve within the buffer
+    inline size_t GetReservedOffset() const { return mReservedOffset; }
+    inline const RingBufferStats& GetStats() const { return mStats; }
+
+private:
+    struct Fence
+    {
+        size_t begin;
+        size_t end;
+        GLsync sync;
+    };
+
+    GLuint mID;
+    size_t mSize;
+    char* mMapped;
+    size_t mHead;               // Where the next span starts looking
+    size_t mReservedOffset;
+    size_t mReservedSize;
+    std::deque<Fence> mFences;  // Oldest first
+    RingBufferStats mStats;
+
+    void WaitFor(Fence& fence);
+};
+
+#endif//__RING_BUFFER__
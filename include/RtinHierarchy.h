@@ -0,0 +1,87 @@
+/*
+ * Copyright (c) 2018 Brendan Barnes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __RTIN_HIERARCHY__
+#define __RTIN_HIERARCHY__
+
+#include "HeightField.h"
+#include <vector>
+
+// Size of the last RtinHierarchy::Extract
+struct RtinStats
+{
+    int vertices;       // Distinct grid vertices referenced
+    size_t triangles;
+    float maxError;     // Threshold the mesh was extracted for
+};
+
+// Right-triangulated irregular network over a (2^k + 1)^2 heightmap, as in
+// Martini (Agafonkin, 2019). Every triangle of the hierarchy is split at the
+// midpoint of its hypotenuse, so each grid vertex is the split point of the
+// one or two triangles sharing a hypotenuse. Build stores, per vertex, the
+// height error at that midpoint of leaving those triangles unsplit, raised
+// to the largest such error below them. Extract then splits wherever that
+// error is above the threshold. A split vertex forces the split of its
+// neighbour across the hypotenuse too, so the mesh has no T-junctions.
+// As in Martini only the split points are measured, so samples between
+// them can be off by somewhat more than the threshold.
+class RtinHierarchy
+{
+public:
+    RtinHierarchy();
+
+    // Error of every vertex of map. Vertices of one level only depend on
+    // the finer levels, so the rows of each level run on the shared
+    // ThreadPool, threadCount 0 uses every hardware thread.
+    void Build(const HeightField& map, unsigned int threadCount = 0);
+    void Clear();
+    inline bool IsEmpty() const { return mErrors.empty(); }
+
+    // Replace indices with the coarsest mesh whose hypotenuse midpoints are
+    // all within maxError of the map, the Martini error bound rather than
+    // one on every sample. Indices are grid vertices y*n + x, so the mesh
+    // can be drawn over the height texture. Triangles are clockwise in
+    // model space like the full grid.
+    void Extract(float maxError, std::vector<unsigned int>& indices, RtinStats* stats = nullptr);
+
+    inline int GetGridSize() const { return mGridSize; }
+    inline float GetError(int x, int y) const { return mErrors[(size_t)y*mGridSize + x]; }
+    // Bytes held by the error hierarchy
+    inline size_t GetSizeInBytes() const { return mErrors.capacity()*sizeof(float) + mVertexMarks.capacity(); }
+
+private:
+    int mGridSize;
+    std::vector<float> mErrors;     // Row major, one per grid vertex
+
+    // Extract scratch
+    std::vector<unsigned char> mVertexMarks;
+    std::vector<unsigned int>* mIndices;
+    float mMaxError;
+    int mVertexCount;
+
+    // Triangle with hypotenuse a-b and right angle at c
+    void ExtractTriangle(int ax, int ay, int bx, int by, int cx, int cy);
+    void AddVertex(int x, int y);
+};
+
+#endif//__RTIN_HIERARCHY__
\ No newline at end of file
@@ -37,12 +37,21 @@ private:
     {
         std::string VertexSource;
         std::string FragmentSource;
+        std::string TessControlSource;      // Empty when the file has no tess_control section
+        std::string TessEvaluationSource;   // Empty when the file has no tess_evaluation section
     };
     GLuint mID;
+
+    // Compile one stage, returns 0 and prints the log on failure
+    static GLuint CompileStage(GLenum type, const std::string& source, const char* name);
 public:
     Shader() {}
     Shader(std::string& filepath);
     ~Shader();
+    // Split a file into the stages following each "#shader vertex",
+    // "#shader tess_control", "#shader tess_evaluation" and
+    // "#shader fragment" line. A line '#include "file"' inside a section
+    // is replaced by the whole of file, relative to filepath's directory.
     ShaderSource ParseShader(std::string& filepath);
     void CompileShader(ShaderSource shaderSource);
     const GLuint inline GetID() {return mID;}
@@ -25,33 +25,189 @@
 #define __TERRAIN__
 
 #include "Mesh.h"
+#include "HeightField.h"
+#include "HeightFieldWriter.h"
+#include "TerrainPipeline.h"
+#include "HeightQuantizer.h"
+#include "GridIndexCache.h"
+#include "Texture.h"
+#include "VertexLayout.h"
+#include "RingBuffer.h"
+#include "CdlodQuadtree.h"
+#include "ElevationBounds.h"
+#include "Frustum.h"
+#include "RtinHierarchy.h"
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
 #include "vmath.h"
 
+// Where the vertex shader gets the terrain grid from
+enum class TerrainRenderMode
+{
+    VERTEX_ATTRIBUTES = 0,  // Interleaved position and octahedral normal, 16 bytes per vertex
+    HEIGHT_TEXTURE = 1,     // x/y from gl_VertexID, height and normal from an R32F texture
+    CDLOD = 2,              // Height texture drawn as LOD patches chosen by a CdlodQuadtree
+    TESSELLATION = 3,       // Height texture over a coarse patch grid the GPU tessellates by
+                            // screen size, needs tessellation.glsl instead of render.glsl
+    RTIN = 4                // Height texture drawn with the RTIN triangles within an error bound
+};
+
+// How heights are stored between regenerations and sent to the GPU.
+// Only the height texture modes read the quantized form.
+enum class HeightFormat
+{
+    FLOAT32 = 0,    // R32F texture
+    UNORM16 = 1     // GL_R16 relative to min/maxElevation, half the memory
+};
+
+// Grid chunks and triangles of the last Terrain::Render, see GridIndices
+struct TerrainCullStats
+{
+    int drawnChunks;
+    int culledChunks;       // Outside the view frustum
+    size_t drawnTriangles;
+    size_t culledTriangles;
+};
+
+// Stages of one terrain generation, in order
+enum class TerrainJobState
+{
+    QUEUED = 0,     // Waiting for the previous generation to be uploaded
+    GENERATING = 1, // Diamond-square on a worker thread
+    MESHING = 2,    // Normals, vertices or quantization on a worker thread
+    READY = 3,      // Waiting for Terrain::Update to upload it
+    DONE = 4,       // On screen
+    CANCELLED = 5   // Replaced by a newer request before it started
+};
+
+// Handle to a terrain generation started by Terrain::GenTerrainAsync. Safe
+// to poll from any thread.
+class TerrainJob
+{
+public:
+    inline TerrainJobState GetState() const { return mState.load(); }
+    inline bool IsFinished() const { return GetState() >= TerrainJobState::DONE; }
+    // Rough fraction of the work done, from 0 to 1
+    float GetProgress() const;
+    inline unsigned int GetSeed() const { return mSeed; }
+
+private:
+    friend class Terrain;
+
+    TerrainJob(unsigned char detailLevel, float range, unsigned int seed,
+        TerrainRenderMode renderMode, HeightFormat heightFormat, IndexLayout indexLayout, int maxPreviewSize);
+
+    void SetState(TerrainJobState state);
+    // Block until the CPU phase is over
+    void WaitUntilReady();
+
+    // Requested terrain, fixed when the job is created
+    const unsigned char mDetailLevel;
+    const float mRange;
+    const unsigned int mSeed;
+    const TerrainRenderMode mRenderMode;
+    const HeightFormat mHeightFormat;
+    const IndexLayout mIndexLayout;
+    const int mMaxPreviewSize;  // Largest progressive preview, 0 for none
+
+    // Results of the CPU phase
+    float mMinElevation;
+    float mMaxElevation;
+    float mQuantizationError;
+    void* mStagingSpan;         // Ring span the vertices are written into, if any
+    std::shared_ptr<GridIndices> mGridIndices;  // Built on the worker, uploaded with the rest
+    std::vector<ElevationBounds> mChunkBounds;  // Of each chunk of mGridIndices
+    size_t mStagingOffset;
+
+    std::atomic<TerrainJobState> mState;
+    std::atomic<float> mGenerationProgress;
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+};
+
 class Terrain : public Mesh
 {
 private:
+    // Written by the worker thread while a job is generating or meshing
+    HeightField mHeightField;   // Digital Elevation Model
+    QuantizedHeightField mQuantizedField;   // 16-bit copy for HeightFormat::UNORM16
+    TerrainPipeline mPipeline;  // Heightmap generator and meshing stages
+    std::vector<vmath::vec3> mNormals;      // Scratch normals, reused between calls
+    std::vector<TerrainVertex> mVertices;   // Vertices when there is no staging ring
+    CdlodQuadtree mNextQuadtree;            // Quadtree of the terrain being generated
+    RtinHierarchy mNextRtin;                // RTIN errors of the terrain being generated
+
+    // Latest progressive preview, shared with the worker
+    std::mutex mPreviewMutex;
+    HeightField mPreview;       // Decimated copy of the last finished level
+    float mPreviewMin;
+    float mPreviewMax;
+    unsigned int mPreviewVersion;
+
+    // Render thread only
+    std::shared_ptr<TerrainJob> mJob;       // Generating, or ready to upload
+    std::shared_ptr<TerrainJob> mQueuedJob; // Starts once mJob is uploaded
+    std::shared_ptr<GridIndices> mGridIndices;
+    IndexLayout mIndexLayout;   // Layout used for the next index buffer
+    Texture mHeightTexture;     // Heights for TerrainRenderMode::HEIGHT_TEXTURE
+    TerrainRenderMode mRenderMode;  // Used by the next generation
+    HeightFormat mHeightFormat;     // Used by the next generation
+    TerrainRenderMode mDrawMode;    // Of the terrain on screen
+    HeightFormat mDrawFormat;       // Of the terrain on screen
+    float mQuantizationError;   // Largest height error of the 16-bit copy
+    size_t mHeightBytes;        // CPU heightmap bytes, taken when the terrain was uploaded
+    int mGridSize;              // Vertices per side of the current terrain
+    size_t mVertexBytes;        // GPU bytes of per vertex data
+    RingBuffer mStaging;        // Mapped memory vertices are written into
+    int mMaxPreviewSize;        // Used by the next generation
+    unsigned int mShownPreviewVersion;
+
+    // Camera given to SetView
+    vmath::vec3 mViewEye;
+    Frustum mViewFrustum;
+    float mViewportHeight;
+    float mViewFovY;
+
+    // Chunk culling of the full grid, render thread only
+    std::vector<ElevationBounds> mChunkBounds;  // Empty when every chunk is drawn
+    std::vector<GLsizei> mDrawCounts;           // Index ranges of the visible chunks
+    std::vector<const void*> mDrawOffsets;
+    TerrainCullStats mCullStats;
 
-    float** genMap(int length)
-    {
-    	const int n = length;
-
-    	float** map = new float *[n];
-    	for(int i = 0; i < n; i++)
-    	{
-    		map[i] = new float[n];
-    		for(int j = 0; j < n; j++)
-            {
-                map[i][j] = 0.0f;
-            }
-    	}
-    	return map;
-    }
-
-    double fRand(float fMin, float fMax)
-    {
-    	float f = (float)rand() / RAND_MAX;
-    	return fMin + f * (fMax - fMin);
-    }
+    // TerrainRenderMode::CDLOD, render thread only
+    CdlodQuadtree mQuadtree;
+    CdlodSelection mSelection;  // Nodes drawn by the last Render
+    VertexBuffer mInstances;    // mSelection's nodes, whole ones first
+    unsigned int mInstanceCapacity;
+    std::shared_ptr<GridIndices> mPatchIndices;
+    std::shared_ptr<GridIndices> mQuarterPatchIndices;
+    float mLodPixelsPerQuad;
+
+    // TerrainRenderMode::TESSELLATION, mVbo and mIbo hold the patch grid
+    int mPatchCount;
+    float mTessPixelsPerEdge;
+
+    // TerrainRenderMode::RTIN, render thread only. mIbo holds the mesh.
+    RtinHierarchy mRtin;
+    std::vector<unsigned int> mRtinIndices;
+    RtinStats mRtinStats;
+    float mRtinMaxError;
+
+    void StartJob(const std::shared_ptr<TerrainJob>& job);
+    void RunCpuPhase(TerrainJob& job);
+    void PublishPreview(const HeightField& map, int sideLength, int maxPreviewSize);
+    bool UploadPreview();
+    void Upload(TerrainJob& job);
+    void UploadVertexBuffer(const TerrainJob& job, int n);
+    void AcquirePatchIndices();
+    void UploadPatchGrid(int n);
+    void UploadRtinMesh();
+    void RenderChunks(Shader* shader);
+    void RenderLod(Shader* shader);
+    void RenderPatches(Shader* shader);
 
 public:
     Terrain();
@@ -59,7 +215,98 @@ public:
     float minElevation;
     float maxElevation;
 
-    void GenTerrain(unsigned char detailLevel, float range);
+    // Generate and upload a terrain, blocking until it is on screen
+    void GenTerrain(unsigned char detailLevel, float range, unsigned int seed);
+    // Generate a terrain on the shared ThreadPool while the current one keeps
+    // rendering. Update swaps it in once ready. A request made while another
+    // is generating replaces any request still queued behind it.
+    std::shared_ptr<TerrainJob> GenTerrainAsync(unsigned char detailLevel, float range, unsigned int seed);
+    // Call once per frame on the render thread. Uploads a finished job and
+    // returns true when a new terrain was swapped in. In progressive mode it
+    // otherwise shows the newest preview of the job, without returning true.
+    bool Update();
+    // Block until every requested terrain is on screen
+    void Finish();
+    inline bool IsGenerating() const { return mJob != nullptr; }
+    // Vertices per side of the terrain or preview on screen
+    inline int GetGridSize() const { return mGridSize; }
+
+    // Binds what the current render mode needs and draws with the shader
+    void Render(Shader* shader);
+    // Last stage of a TerrainPipeline: puts a mesh made elsewhere on screen
+    // as TerrainRenderMode::VERTEX_ATTRIBUTES, with the shared grid indices
+    // of its size and layout. A generation still running replaces it once
+    // it finishes.
+    void UploadMesh(const TerrainMesh& mesh, float minHeight, float maxHeight);
+    // Free the GL resources held while the context is still alive
+    void Release();
+
+    // Threads used to generate the heightmap, 0 uses every hardware thread.
+    // Not to be changed while generating.
+    inline void SetThreadCount(unsigned int threadCount) { mPipeline.SetThreadCount(threadCount); }
+
+    // Switch between triangle lists and restart separated strips. Takes
+    // effect immediately when a terrain has already been generated.
+    void SetIndexLayout(IndexLayout layout);
+    inline IndexLayout GetIndexLayout() const { return mIndexLayout; }
+    // Primitive type to pass to Render for the current index buffer
+    inline GLenum GetPrimitiveType() const { return mGridIndices ? mGridIndices->primitive : GL_TRIANGLES; }
+
+    // Progressive mode shows each coarse level of a background generation as
+    // it finishes, so a rough terrain appears at once and refines frame by
+    // frame. Levels are decimated to at most maxPreviewSize vertices a side
+    // and drawn from a height texture. At most one is uploaded per frame.
+    // Takes effect on the next GenTerrain, 0 turns it off.
+    inline void SetProgressive(int maxPreviewSize) { mMaxPreviewSize = maxPreviewSize; }
+    inline int GetProgressive() const { return mMaxPreviewSize; }
+
+    // Camera used to cull chunks and pick CDLOD nodes, set before each
+    // Render. eye and mvp are in the terrain's model space, fovY is in
+    // degrees. Until it is called nothing is culled.
+    void SetView(const vmath::vec3& eye, const vmath::mat4& mvp, float viewportHeight, float fovY);
+    // Chunks of the full grid drawn and culled by the last Render
+    inline const TerrainCullStats& GetCullStats() const { return mCullStats; }
+    // Pixels a full resolution quad covers where the second LOD starts. The
+    // triangle count of a frame is about proportional to 1/pixelsPerQuad^2
+    // and does not depend on the map size.
+    inline void SetLodDetail(float pixelsPerQuad) { mLodPixelsPerQuad = pixelsPerQuad; }
+    inline const CdlodStats& GetLodStats() const { return mSelection.stats; }
+    // Pixels each tessellated edge should cover. Triangles follow the
+    // screen, up to a full resolution grid within each patch.
+    inline void SetTessellationDetail(float pixelsPerEdge) { mTessPixelsPerEdge = pixelsPerEdge; }
+    // Patches of the coarse grid, 0 unless tessellating
+    inline int GetPatchCount() const { return mPatchCount; }
+    // Largest height difference between the RTIN mesh and the heightmap at
+    // the hypotenuse midpoints, see RtinHierarchy. The error hierarchy is
+    // kept, so a new bound only re-extracts the mesh and takes effect
+    // immediately.
+    void SetRtinMaxError(float maxError);
+    inline float GetRtinMaxError() const { return mRtinMaxError; }
+    inline const RtinStats& GetRtinStats() const { return mRtinStats; }
+
+    // Takes effect on the next GenTerrain
+    inline void SetRenderMode(TerrainRenderMode mode) { mRenderMode = mode; }
+    inline TerrainRenderMode GetRenderMode() const { return mRenderMode; }
+    // Mode of the terrain or preview on screen, which decides the shader Render needs
+    inline TerrainRenderMode GetDrawMode() const { return mDrawMode; }
+    inline size_t GetVertexBytes() const { return mVertexBytes; }
+    // Takes effect on the next GenTerrain
+    inline void SetHeightFormat(HeightFormat format) { mHeightFormat = format; }
+    inline HeightFormat GetHeightFormat() const { return mHeightFormat; }
+    // Both are copied on the render thread when a terrain is uploaded, so
+    // they are safe to read while the worker generates the next one
+    inline float GetQuantizationError() const { return mQuantizationError; }
+    inline const RingBufferStats& GetStagingStats() const { return mStaging.GetStats(); }
+    // GPU bytes of the staging ring, 0 unless a vertex attribute job is in flight
+    inline size_t GetStagingBytes() const { return mStaging.GetSize(); }
+    // Write the heightmap on screen to path, see HeightFieldWriter. Only
+    // the 32-bit heights can be exported, so it fails under
+    // HeightFormat::UNORM16, after UploadMesh and while generating.
+    bool Export(const std::string& path, HeightFileFormat format) const;
+    // CPU bytes held by the heightmap between regenerations
+    inline size_t GetHeightBytes() const { return mHeightBytes; }
+    // Bytes of the index buffers in use, the grid's or the CDLOD patches'
+    size_t GetIndexBytes() const;
 };
 
 #endif//__TERRAIN__
\ No newline at end of file
@@ -0,0 +1,97 @@
+/*
+ * Copyright (c) 2018 Brendan Barnes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __TERRAIN_BATCH__
+#define __TERRAIN_BATCH__
+
+#include "HeightFieldWriter.h"
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+// Totals of one TerrainBatch::Run
+struct TerrainBatchStats
+{
+    size_t terrains;        // Written successfully
+    size_t failed;          // Could not be written
+    size_t bytes;           // Heights written, without headers
+    double seconds;         // Wall time of the whole run
+    double stallSeconds;    // Worker time spent waiting for the writer
+    size_t peakQueued;      // Most terrains waiting for the writer at once
+    size_t bufferBytes;     // Heightmap memory held by every arena
+};
+
+// Generates one terrain per seed and detail level and writes each to its
+// own file, without any GL. Terrains are independent, so each runs whole on
+// one worker of a dedicated ThreadPool rather than being split across them.
+//
+// Every worker owns an arena: a TerrainPipeline and a few heightmaps that
+// are reused for every terrain it makes. A finished heightmap is handed to
+// a single writer thread as is, and the worker moves on to its next one.
+// When all of a worker's heightmaps are still waiting to be written it
+// blocks, so memory stays at workers*buffersPerWorker maps however far the
+// disk falls behind.
+class TerrainBatch
+{
+public:
+    TerrainBatch();
+
+    // Directory the files are written into, which must exist. Each terrain
+    // is dem_<seed>_<detailLevel> with the format's extension.
+    inline void SetOutputDirectory(const std::string& directory) { mDirectory = directory; }
+    inline void SetFormat(HeightFileFormat format) { mFormat = format; }
+    // Open files O_DIRECT, see HeightFieldWriter
+    inline void SetDirectIO(bool direct) { mDirectIO = direct; }
+    // Every level from minLevel to maxLevel for each seed
+    inline void SetDetailLevels(unsigned char minLevel, unsigned char maxLevel) { mMinLevel = minLevel; mMaxLevel = maxLevel; }
+    inline void SetSeeds(uint32_t firstSeed, uint32_t count) { mFirstSeed = firstSeed; mSeedCount = count; }
+    inline void SetRange(float range) { mRange = range; }
+    // 0 uses every hardware thread
+    inline void SetWorkerCount(unsigned int workerCount) { mWorkerCount = workerCount; }
+    // Heightmaps per worker. 2 lets a worker generate while its last
+    // terrain is written; more absorbs uneven disk latency.
+    inline void SetBuffersPerWorker(int bufferCount) { mBuffersPerWorker = bufferCount > 0 ? bufferCount : 1; }
+    // Bytes of each write, the writer's buffer
+    inline void SetWriteBufferSize(size_t bytes) { mWriteBufferSize = bytes; }
+
+    inline size_t GetJobCount() const { return (size_t)mSeedCount*(mMaxLevel - mMinLevel + 1); }
+    unsigned int GetWorkerCount() const;
+
+    // Generate and write every terrain, returning once all are on disk
+    TerrainBatchStats Run();
+
+private:
+    std::string mDirectory;
+    HeightFileFormat mFormat;
+    bool mDirectIO;
+    unsigned char mMinLevel;
+    unsigned char mMaxLevel;
+    uint32_t mFirstSeed;
+    uint32_t mSeedCount;
+    float mRange;
+    unsigned int mWorkerCount;
+    int mBuffersPerWorker;
+    size_t mWriteBufferSize;
+};
+
+#endif//__TERRAIN_BATCH__
\ No newline at end of file
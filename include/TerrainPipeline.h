@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2018 Brendan Barnes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __TERRAIN_PIPELINE__
+#define __TERRAIN_PIPELINE__
+
+#include "HeightField.h"
+#include "DiamondSquare.h"
+#include "GridLayout.h"
+#include "vmath.h"
+#include <cstddef>
+#include <stdint.h>
+#include <vector>
+
+// Vertex of TerrainRenderMode::VERTEX_ATTRIBUTES
+struct TerrainVertex
+{
+    float x, y, z;
+    uint32_t normal;    // PackOctahedral
+};
+
+// Terrain's vertex layout is three floats then two shorts, 16 bytes apart
+static_assert(sizeof(TerrainVertex) == 16, "TerrainVertex must match the 16 byte vertex stride");
+static_assert(offsetof(TerrainVertex, normal) == 12, "TerrainVertex::normal must follow the position");
+
+// Grid mesh written by the TerrainPipeline stages. Owned by the caller and
+// meant to be reused: vectors are resized and never shrunk, so meshing
+// terrains of one size again does not allocate.
+struct TerrainMesh
+{
+    int gridSize;       // Vertices per side
+    IndexLayout layout;
+    std::vector<TerrainVertex> vertices;    // gridSize^2, row by row
+    std::vector<unsigned int> indices;      // BuildGridIndices order
+    std::vector<vmath::vec3> normals;       // Unpacked normals of ComputeNormals
+
+    TerrainMesh() : gridSize(0), layout(IndexLayout::TRIANGLE_LIST) {}
+};
+
+// Heightmap generation and meshing without any GL, so a terrain can be
+// made in a process with no graphics stack. The stages run in order
+//
+//     Generate -> BuildMesh -> ComputeNormals -> Terrain::UploadMesh
+//
+// and a caller stops after the last one it needs, e.g. after Generate to
+// export a DEM. Every stage writes into buffers the caller owns.
+// Model space matches Terrain: cell (x, y) of an n x n map sits at
+// (2x/(n-1) - 1, 1 - 2y/(n-1), height).
+class TerrainPipeline
+{
+public:
+    // Threads used by every stage, 0 uses every hardware thread
+    inline void SetThreadCount(unsigned int threadCount) { mGenerator.SetThreadCount(threadCount); }
+    inline unsigned int GetThreadCount() const { return mGenerator.GetThreadCount(); }
+    // For progress, level callbacks and the other generator settings
+    inline DiamondSquare& GetGenerator() { return mGenerator; }
+
+    // Fill map with a (2^detailLevel + 1)^2 DEM, reusing its allocation.
+    // Its elevation range is kept for GetMin/MaxElevation.
+    void Generate(HeightField& map, unsigned char detailLevel, float range, uint32_t seed);
+    inline float GetMinElevation() const { return mGenerator.GetMinElevation(); }
+    inline float GetMaxElevation() const { return mGenerator.GetMaxElevation(); }
+
+    // Positions and triangle indices of the map's grid. Normals are left 0
+    // until ComputeNormals.
+    void BuildMesh(HeightFieldView<const float> map, IndexLayout layout, TerrainMesh& mesh) const;
+    // Positions only, into gridSize^2 vertices, e.g. in mapped GPU memory
+    void BuildVertices(HeightFieldView<const float> map, TerrainVertex* vertices) const;
+
+    // Smooth normals of the map into mesh.normals, packed into its vertices
+    void ComputeNormals(HeightFieldView<const float> map, TerrainMesh& mesh) const;
+    // Same for vertices outside a TerrainMesh. normals is scratch of
+    // gridSize^2 entries and vertices may be nullptr to skip packing.
+    void ComputeNormals(HeightFieldView<const float> map, vmath::vec3* normals, TerrainVertex* vertices) const;
+
+private:
+    DiamondSquare mGenerator;
+};
+
+#endif//__TERRAIN_PIPELINE__
\ No newline at end of file
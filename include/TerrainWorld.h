@@ -0,0 +1,163 @@
+/*
+ * Copyright (c) 2018 Brendan Barnes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#ifndef __TERRAIN_WORLD__
+#define __TERRAIN_WORLD__
+
+#include "Mesh.h"
+#include "HeightField.h"
+#include "GridIndexCache.h"
+#include "Texture.h"
+#include <atomic>
+#include <map>
+#include <memory>
+#include <utility>
+#include <vector>
+
+// One square of a TerrainWorld. Chunk (x, y) covers world x in
+// [2x - 1, 2x + 1] and world y in [-2y - 1, -2y + 1], the same [-1,1]^2
+// square a Terrain covers, moved over. Rows grow towards -y as in Terrain.
+struct TerrainChunk
+{
+    // Sides of the chunk, indexing innerEdges
+    enum Side { TOP = 0, BOTTOM = 1, LEFT = 2, RIGHT = 3 };
+
+    int x;
+    int y;
+    HeightField heights;        // CPU copy, dropped first when over budget
+    float minElevation;
+    float maxElevation;
+    // Heights one sample in from each side: rows 1 and n-2, columns 1 and
+    // n-2. Neighbours copy them into the apron of their textures, so they
+    // outlive heights.
+    std::vector<float> innerEdges[4];
+    Texture texture;            // R32F heights with a one texel apron, empty while not resident
+    bool aproned;               // Render thread: resident neighbours' aprons hold innerEdges
+    std::atomic<bool> generated;    // Set by the worker once heights are final
+
+    TerrainChunk(int chunkX, int chunkY)
+        : x(chunkX), y(chunkY), minElevation(0.0f), maxElevation(0.0f), aproned(false), generated(false) {}
+};
+
+struct TerrainWorldStats
+{
+    int residentChunks;     // Height textures on the GPU
+    int cachedChunks;       // Heightmaps held on the CPU
+    int pendingChunks;      // Generating on the ThreadPool
+    size_t cpuBytes;        // Heightmaps, including those being generated
+    size_t gpuBytes;        // Height textures, the shared index buffer excluded
+    unsigned int generated; // Totals since the world was created
+    unsigned int uploaded;
+    unsigned int evicted;   // Textures dropped, by distance or budget
+};
+
+// Unbounded terrain made of (2^detailLevel + 1)^2 chunks generated around
+// the camera. Every chunk is a pure function of the world seed and its
+// coordinates: its corners and border rows come from 1D midpoint
+// displacement keyed on world coordinates, so two neighbours compute the
+// same shared edge, and diamond-square fills the interior from a per-chunk
+// seed. Chunks can therefore be dropped at any time and regenerated later.
+//
+// Update streams chunks in nearest first and keeps CPU heightmaps and GPU
+// textures within fixed budgets, evicting the farthest chunks, so memory
+// stays flat however far the camera travels. Chunks are drawn from height
+// textures with one index buffer shared by all of them. Each texture has a
+// one texel apron holding the neighbours' heights next to the shared edges,
+// so normals along a seam are the same on both sides of it.
+class TerrainWorld
+{
+public:
+    TerrainWorld(unsigned char detailLevel, float range, unsigned int seed);
+
+    // Chunks within radius of the camera's chunk, on both axes, are loaded
+    inline void SetViewRadius(int radius) { mViewRadius = radius; }
+    inline int GetViewRadius() const { return mViewRadius; }
+    // Byte budgets of CPU heightmaps and GPU height textures. Both should
+    // hold every chunk in view, otherwise the farthest ones keep reloading.
+    inline void SetMemoryBudget(size_t cpuBytes, size_t gpuBytes) { mCpuBudget = cpuBytes; mGpuBudget = gpuBytes; }
+    // Chunks generating at once and uploaded per Update, to bound the work per frame
+    inline void SetStreamingLimits(int maxPending, int uploadsPerUpdate) { mMaxPending = maxPending; mUploadsPerUpdate = uploadsPerUpdate; }
+    void SetIndexLayout(IndexLayout layout);
+
+    // Call once per frame on the render thread with the camera's world x/y
+    void Update(float cameraX, float cameraY);
+    // Draws every resident chunk with the shader
+    void Render(Shader* shader);
+    // Free every chunk and GL resource while the context is still alive
+    void Release();
+
+    // Chunk whose square holds the world point (x, y)
+    static std::pair<int, int> GetChunkAt(float x, float y);
+    // Vertices per chunk side
+    inline int GetGridSize() const { return mGridSize; }
+    inline unsigned int GetSeed() const { return mSeed; }
+    // Elevation range of every chunk generated so far, only ever widens
+    inline float GetMinElevation() const { return mMinElevation; }
+    inline float GetMaxElevation() const { return mMaxElevation; }
+    inline const TerrainWorldStats& GetStats() const { return mStats; }
+
+    // Fill chunk (x, y) of the world in map, without any GL. Thread safe.
+    static void GenerateChunk(HeightField& map, unsigned char detailLevel, float range, unsigned int seed,
+        int x, int y, float& minElevation, float& maxElevation);
+
+private:
+    typedef std::pair<int, int> Key;
+
+    const unsigned char mDetailLevel;
+    const float mRange;
+    const unsigned int mSeed;
+    const int mGridSize;
+    int mViewRadius;
+    size_t mCpuBudget;
+    size_t mGpuBudget;
+    int mMaxPending;
+    int mUploadsPerUpdate;
+    float mMinElevation;
+    float mMaxElevation;
+    int mCenterX;               // Camera chunk of the last Update
+    int mCenterY;
+
+    std::map<Key, std::shared_ptr<TerrainChunk>> mChunks;
+    IndexLayout mIndexLayout;
+    std::shared_ptr<GridIndices> mGridIndices;
+    Mesh mMesh;                 // Vertex array holding the shared index buffer
+    TerrainWorldStats mStats;
+    std::vector<float> mTexels;     // Aproned heights of the chunk being uploaded
+
+    // Chebyshev distance from the camera chunk
+    int GetDistance(const TerrainChunk& chunk) const;
+    bool IsInView(const TerrainChunk& chunk) const;
+    // Chunk (x, y) if it is loaded or loading, otherwise null
+    TerrainChunk* FindChunk(int x, int y);
+    void StartChunk(int x, int y);
+    void UploadChunk(TerrainChunk& chunk);
+    // Copy the inner edges of a newly generated chunk into the aprons of
+    // its resident neighbours
+    void ShareEdges(TerrainChunk& chunk);
+    void EvictTexture(TerrainChunk& chunk);
+    // Evict the farthest chunk that is farther than distance and holds GPU
+    // or CPU memory, returns false when there is none
+    bool EvictFarthest(bool gpu, int distance);
+    void UpdateStats();
+};
+
+#endif//__TERRAIN_WORLD__
\ No newline at end of file
@@ -0,0 +1,66 @@
+/*
+ * Copyright (c) 2018 Brendan Barnes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __TEXTURE__
+#define __TEXTURE__
+
+#include "GLCall.h"
+#include "GpuMemory.h"
+
+// Single level 2D texture sampled with texelFetch, so no filtering or mipmaps
+class Texture
+{
+public:
+    Texture();
+    ~Texture();
+
+    // Allocate width x height texels of internalFormat and upload data, if
+    // any. rowLength is the number of texels between the starts of rows in
+    // data, 0 when they are tightly packed.
+    void CreateTexture(GLenum internalFormat, int width, int height,
+        GLenum format, GLenum type, const void* data, int rowLength = 0);
+    // Replace every texel, keeping the existing storage
+    void Update(GLenum format, GLenum type, const void* data, int rowLength = 0);
+    // Replace the width x height texels starting at texel (x, y)
+    void UpdateRegion(int x, int y, int width, int height, GLenum format, GLenum type, const void* data, int rowLength = 0);
+    // Delete the texture and its storage
+    void Release();
+    void Bind(unsigned int unit) const;
+    inline GLuint GetID() const { return mID; }
+    inline int GetWidth() const { return mWidth; }
+    inline int GetHeight() const { return mHeight; }
+    inline GLenum GetInternalFormat() const { return mInternalFormat; }
+    inline size_t GetSize() const { return mSize; }
+
+    // Bytes per texel of the sized formats used here, 4 for anything else
+    static size_t GetTexelSize(GLenum internalFormat);
+
+private:
+    GLuint mID;
+    int mWidth;
+    int mHeight;
+    GLenum mInternalFormat;
+    size_t mSize;       // Bytes of storage held
+};
+
+#endif//__TEXTURE__
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2018 Brendan Barnes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __THREAD_POOL__
+#define __THREAD_POOL__
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads fed from a single task queue.
+class ThreadPool
+{
+public:
+    // threadCount of 0 starts one worker per hardware thread
+    explicit ThreadPool(unsigned int threadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void Enqueue(std::function<void()> task);
+
+    // Split [0, count) into bands and call func(begin, end) for each band,
+    // returning once every band has finished. The calling thread works on
+    // bands too, so it is safe to call from inside a pool task. At most
+    // maxThreads threads take part; 0 means the whole pool plus the caller.
+    // If a band throws, the bands not yet started are skipped and the first
+    // exception is rethrown here once every band has stopped.
+    void ParallelFor(int count, unsigned int maxThreads, const std::function<void(int, int)>& func);
+
+    inline unsigned int GetThreadCount() const { return (unsigned int)mWorkers.size(); }
+
+    // Process-wide pool shared by the terrain generators
+    static ThreadPool& GetShared();
+    // ParallelFor on the shared pool. With maxThreads 1 func runs on the
+    // caller and the shared pool is never started, so single threaded
+    // generators, like one per batch worker, do not spin up an idle pool.
+    static void SharedParallelFor(int count, unsigned int maxThreads, const std::function<void(int, int)>& func);
+
+private:
+    std::vector<std::thread> mWorkers;
+    std::queue<std::function<void()>> mTasks;
+    std::mutex mMutex;
+    std::condition_variable mCondition;
+    bool mStopping;
+
+    void WorkerLoop();
+};
+
+#endif//__THREAD_POOL__
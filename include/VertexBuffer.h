@@ -25,6 +25,7 @@
 #define __VERTEX_BUFFER__
 
 #include "GLCall.h"
+#include "GpuMemory.h"
 
 class VertexBuffer
 {
@@ -32,14 +33,24 @@ public:
     VertexBuffer();
     ~VertexBuffer();
     
+    // Upload data, reusing the existing buffer object. Storage is only
+    // reallocated when the size changes; otherwise it is overwritten in place.
     void CreateBuffer(const void* data, unsigned int count, unsigned int vertexSize);
+    // Overwrite size bytes at offset, which must fit in the current storage
+    void UpdateBuffer(const void* data, size_t offset, size_t size);
+    // Fill the buffer on the GPU from offset in source, e.g. a RingBuffer
+    void CopyBuffer(GLuint source, size_t offset, unsigned int count, unsigned int vertexSize);
+    // Delete the buffer object and its storage
+    void Release();
     void Bind() const;
     inline GLuint GetID() { return mID; }
     inline unsigned int GetCount() {return mCount;}
+    inline size_t GetSize() const { return mSize; }
 
 private:
     GLuint mID;
     unsigned int mCount;
+    size_t mSize;       // Bytes of storage held
 };
 
 #endif//__VERTEX_BUFFER__
\ No newline at end of file
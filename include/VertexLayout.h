@@ -0,0 +1,85 @@
+/*
+ * Copyright (c) 2018 Brendan Barnes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __VERTEX_LAYOUT__
+#define __VERTEX_LAYOUT__
+
+#include "GLCall.h"
+#include "VertexPacking.h"
+#include <vector>
+
+// One attribute of a vertex, as handed to glVertexAttribPointer
+struct VertexAttribute
+{
+    unsigned int location;
+    GLint size;             // Components, 4 for the packed 2_10_10_10 types
+    GLenum type;
+    GLboolean normalized;
+    unsigned int offset;    // Bytes from the start of the vertex
+};
+
+// Describes how the attributes of one vertex sit in a buffer. Attributes
+// are added in memory order and interleaved, each starting on 4 bytes.
+class VertexLayout
+{
+public:
+    VertexLayout() : mStride(0) {}
+
+    VertexLayout& Add(unsigned int location, GLint size, GLenum type, bool normalized = false)
+    {
+        VertexAttribute attribute = { location, size, type, (GLboolean)(normalized ? GL_TRUE : GL_FALSE), mStride };
+        mAttributes.push_back(attribute);
+        mStride += (GetAttributeSize(size, type) + 3)/4*4;
+        return *this;
+    }
+
+    inline const std::vector<VertexAttribute>& GetAttributes() const { return mAttributes; }
+    inline unsigned int GetStride() const { return mStride; }
+
+    static unsigned int GetAttributeSize(GLint size, GLenum type)
+    {
+        switch(type)
+        {
+            case GL_INT_2_10_10_10_REV:
+            case GL_UNSIGNED_INT_2_10_10_10_REV:
+                return 4;
+            case GL_BYTE:
+            case GL_UNSIGNED_BYTE:
+                return size;
+            case GL_SHORT:
+            case GL_UNSIGNED_SHORT:
+            case GL_HALF_FLOAT:
+                return 2*size;
+            case GL_DOUBLE:
+                return 8*size;
+            default:
+                return 4*size;
+        }
+    }
+
+private:
+    std::vector<VertexAttribute> mAttributes;
+    unsigned int mStride;
+};
+
+#endif//__VERTEX_LAYOUT__
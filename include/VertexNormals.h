@@ -0,0 +1,39 @@
+/*
+ * Copyright (c) 2018 Brendan Barnes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __VERTEX_NORMALS__
+#define __VERTEX_NORMALS__
+
+#include "HeightField.h"
+#include "Simd.h"
+#include "vmath.h"
+
+// Smooth vertex normals taken straight from a heightfield by central
+// differences, one normal per cell written to normals[y*width + x].
+// Columns run along +x and rows along -y, spacing apart, matching the grid
+// Terrain builds. Edge cells use one sided differences. Rows are split over
+// the shared ThreadPool; threadCount of 0 uses every hardware thread.
+void ComputeVertexNormals(HeightFieldView<const float> map, float spacing, vmath::vec3* normals,
+    unsigned int threadCount = 0, SimdLevel level = GetBestSimdLevel());
+
+#endif//__VERTEX_NORMALS__
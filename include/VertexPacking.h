@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2018 Brendan Barnes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef __VERTEX_PACKING__
+#define __VERTEX_PACKING__
+
+#include <math.h>
+#include <stdint.h>
+
+// Packing helpers for the normalized vertex formats of VertexLayout.h,
+// without any GL. Signed values are clamped to [-1, 1] and rounded to the
+// nearest step.
+inline int16_t PackSnorm16(float value)
+{
+    value = value < -1.0f ? -1.0f : (value > 1.0f ? 1.0f : value);
+    return (int16_t)floorf(value*32767.0f + 0.5f);
+}
+
+// x, y and z in the low 30 bits and w in the top 2, for GL_INT_2_10_10_10_REV
+inline uint32_t PackSnorm2_10_10_10(float x, float y, float z, float w)
+{
+    float values[4] = { x, y, z, w };
+    const float scales[4] = { 511.0f, 511.0f, 511.0f, 1.0f };
+    const uint32_t masks[4] = { 0x3FFu, 0x3FFu, 0x3FFu, 0x3u };
+    uint32_t packed = 0;
+    for(int i = 0; i < 4; i++)
+    {
+        float v = values[i] < -1.0f ? -1.0f : (values[i] > 1.0f ? 1.0f : values[i]);
+        int32_t q = (int32_t)floorf(v*scales[i] + 0.5f);
+        packed |= ((uint32_t)q & masks[i]) << (10*i);
+    }
+    return packed;
+}
+
+// Unit vector folded onto an octahedron and stored as two normalized
+// shorts, x in the low half. Decoded in render.glsl by DecodeOctahedral.
+inline uint32_t PackOctahedral(float x, float y, float z)
+{
+    float inv = 1.0f/(fabsf(x) + fabsf(y) + fabsf(z));
+    float u = x*inv;
+    float v = y*inv;
+    if(z < 0.0f)
+    {
+        float foldU = (1.0f - fabsf(v))*(u >= 0.0f ? 1.0f : -1.0f);
+        float foldV = (1.0f - fabsf(u))*(v >= 0.0f ? 1.0f : -1.0f);
+        u = foldU;
+        v = foldV;
+    }
+    return (uint16_t)PackSnorm16(u) | ((uint32_t)(uint16_t)PackSnorm16(v) << 16);
+}
+
+#endif//__VERTEX_PACKING__
\ No newline at end of file
@@ -0,0 +1,52 @@
+#shader vertex
+#version 450
+
+layout(location = 2) uniform mat4 projection;
+out float c;
+out vec3 vs_Position;
+out vec3 vs_Normal;
+out float time;
+layout(location = 3) uniform float t;
+layout(location = 4) uniform float maxH;
+layout(location = 5) uniform float minH;
+layout(location = 7) uniform int gridSize;        // Vertices per level side
+layout(location = 14) uniform ivec2 originTexel;  // Texel of the level's first vertex
+layout(location = 15) uniform vec2 levelPosition; // World x/y of the level's first vertex
+layout(location = 16) uniform float levelSpacing; // World distance between the level's vertices
+layout(location = 17) uniform int textureSize;    // Texels per side, the texture wraps around
+layout(binding = 0) uniform sampler2D heightMap;  // r: this level's height, g: the coarser level's
+
+// Height of the vertex j, i cells from the level's first one, alpha of the
+// way to the coarser level's surface
+float height(int j, int i, float alpha)
+{
+    ivec2 texel = (originTexel + ivec2(j, i) + textureSize) % textureSize;
+    vec2 h = texelFetch(heightMap, texel, 0).rg;
+    return mix(h.r, h.g, alpha);
+}
+
+void main()
+{
+    int j = gl_VertexID % gridSize;
+    int i = gl_VertexID / gridSize;
+
+    // The outer eighth of the grid morphs into the coarser level, so the
+    // border lies exactly on its triangles
+    int border = min(min(j, i), min(gridSize - 1 - j, gridSize - 1 - i));
+    float alpha = clamp(1.0 - float(border)/(float(gridSize - 1)/8.0), 0.0, 1.0);
+
+    vec4 newPosition = vec4(levelPosition + vec2(float(j), -float(i))*levelSpacing, height(j, i, alpha), 1.0);
+    // Central differences as textureNormal in render.glsl, the texture has a
+    // texel to spare around the grid
+    float nx = height(j - 1, i, alpha) - height(j + 1, i, alpha);
+    float ny = height(j, i + 1, alpha) - height(j, i - 1, alpha);
+
+    gl_Position = projection * newPosition;
+    c = clamp( (newPosition.z-minH)/(maxH-minH) , 0.0, 1.0);
+    vs_Position = newPosition.xyz;
+    vs_Normal = normalize(vec3(nx, ny, 2.0*levelSpacing));
+    time = t;
+}
+
+#shader fragment
+#include "fragment.glsl"
\ No newline at end of file
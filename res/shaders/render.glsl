@@ -2,7 +2,9 @@
 #version 450
 
 layout(location = 0) in vec4 position;
-layout(location = 1) in vec3 normal;
+layout(location = 1) in vec2 octNormal;
+layout(location = 2) in vec4 node;          // CdlodNode x, y, size, lod
+layout(location = 3) in vec2 morphRange;    // CdlodNode morphStart, morphEnd
 layout(location = 2) uniform mat4 projection;
 out float c;
 out vec3 vs_Position;
@@ -11,86 +13,87 @@ out float time;
 layout(location = 3) uniform float t;
 layout(location = 4) uniform float maxH;
 layout(location = 5) uniform float minH;
+layout(location = 6) uniform bool heightFromTexture;
+layout(location = 7) uniform int gridSize;
+layout(location = 8) uniform bool heightQuantized;
+layout(location = 9) uniform vec2 gridOffset;     // TerrainWorld chunk position
+layout(location = 10) uniform int patchSize;      // Quads per CDLOD patch side, 0 when not drawing patches
+layout(location = 11) uniform vec3 eye;           // Camera in model space
+layout(location = 18) uniform int textureBorder;  // Apron texels around the grid in heightMap, TerrainWorld chunks have 1
+layout(binding = 0) uniform sampler2D heightMap;
+
+// Inverse of PackOctahedral in VertexPacking.h
+vec3 DecodeOctahedral(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+float height(int x, int y)
+{
+    float h = texelFetch(heightMap, ivec2(x, y) + textureBorder, 0).r;
+    // GL_R16 heights are fractions of the elevation range, as in DequantizeHeight
+    return heightQuantized ? minH + h*(maxH - minH) : h;
+}
+
+// Normal from the height texture, as in ComputeVertexNormals when step is 1.
+// Coarser meshes take differences over their own vertex spacing. Border
+// vertices reach into the apron, if any, so neighbouring grids agree.
+vec3 textureNormal(int j, int i, int step, float spacing)
+{
+    int l = max(j - step, -textureBorder);
+    int r = min(j + step, gridSize - 1 + textureBorder);
+    int u = max(i - step, -textureBorder);
+    int d = min(i + step, gridSize - 1 + textureBorder);
+    float nx = (height(l, i) - height(r, i))*2.0/float(r - l);
+    float ny = (height(j, d) - height(j, u))*2.0/float(d - u);
+    return normalize(vec3(nx, ny, 2.0*spacing));
+}
+
+vec3 gridPosition(ivec2 cell, float spacing)
+{
+    return vec3(float(cell.x)*spacing - 1.0, 1.0 - float(cell.y)*spacing, height(cell.x, cell.y));
+}
 
 void main()
 {
     vec4 newPosition = vec4(position.xyz, 1.0);
+    vec3 newNormal = DecodeOctahedral(octNormal);
+    float spacing = 2.0/float(gridSize - 1);
+    if(heightFromTexture && patchSize > 0)
+    {
+        // CDLOD patch vertex, 2^lod cells apart. Odd vertices slide onto
+        // their even neighbour towards the end of the LOD's range, which
+        // turns the patch into the next coarser one before it takes over.
+        int j = gl_VertexID % (patchSize + 1);
+        int i = gl_VertexID / (patchSize + 1);
+        int scale = 1 << int(node.w);
+        ivec2 cell = ivec2(node.xy) + ivec2(j, i)*scale;
+        ivec2 coarse = cell - ivec2(j & 1, i & 1)*scale;
+        vec3 fine = gridPosition(cell, spacing);
+        float morph = clamp((distance(eye, fine) - morphRange.x)/(morphRange.y - morphRange.x), 0.0, 1.0);
+        newPosition = vec4(mix(fine, gridPosition(coarse, spacing), morph), 1.0);
+        newNormal = normalize(mix(textureNormal(cell.x, cell.y, scale, spacing),
+            textureNormal(coarse.x, coarse.y, 2*scale, spacing), morph));
+    }
+    else if(heightFromTexture)
+    {
+        // Same grid as Terrain::BuildVertices and normals as ComputeVertexNormals
+        int j = gl_VertexID % gridSize;
+        int i = gl_VertexID / gridSize;
+        newPosition = vec4(gridOffset + vec2(float(j)*spacing - 1.0, 1.0 - float(i)*spacing), height(j, i), 1.0);
+        newNormal = textureNormal(j, i, 1, spacing);
+    }
     gl_Position = projection * newPosition;
     c = clamp( (newPosition.z-minH)/(maxH-minH) , 0.0, 1.0);
     // TODO: separate modelview and projection matrices
     vs_Position = newPosition.xyz;
-    vs_Normal = normal;
+    vs_Normal = newNormal;
     time = t;
 }
 
 #shader fragment
-#version 450
-// Modified blinn phone shader from Wikipedia
-in float c;
-in float time;
-in vec3 vs_Position;
-in vec3 vs_Normal;
-out vec4 color;
-
-uniform int mode;
-
-const vec3 blue = vec3(0, 0.180, 0.341);
-const vec3 tanC = vec3(0.803, 0.450, 0.196);
-const vec3 green = vec3(0.190, 0.472, 0.064);
-const vec3 brown = vec3(0.301, 0.129, 0.015);
-
-
-const vec3 lightPos = vec3(10.0*cos(time),10.0*sin(time),10.0);
-
-const float lightPower = 150.0;
-
-vec3 diffuseColor = vec3(0.5, 0.5, 0.5);
-const vec3 specColor = vec3(1.0, 1.0, 1.0);
-const float shininess = 2.0;
-const float screenGamma = 2.2;
-
-void main()
-{
-  vec3 ambientColor = vec3(0.0, 0.0, 0.0);
-  if(c >= 0.0 && c < 1.0/3.0)
-  {
-    ambientColor = (-3.0*c + 1.0)*blue + (3.0*c)*tanC; 
-  }
-  else if(c >= 1.0/3.0 && c < 2.0/3.0)
-  {
-    ambientColor = (-3.0*c + 2.0)*tanC + (3.0*c - 1.0)*green; 
-  }
-  else if(c >= 2.0/3.0 && c < 1.0)
-  {
-    ambientColor = (-3.0*c + 3.0)*green + (3.0*c - 2.0)*brown; 
-  }
-  vec3 lightColor = ambientColor;
-  diffuseColor = ambientColor*0.5;
-  ambientColor = ambientColor*0.1;
-  vec3 normal = normalize(vs_Normal);
-  vec3 lightDir = lightPos - vs_Position;
-  float distance = length(lightDir);
-  distance = distance * distance;
-  lightDir = normalize(lightDir);
-
-  float lambertian = max(dot(lightDir,normal), 0.0);
-  float specular = 0.0;
-
-  if(lambertian > 0.0) {
-
-    vec3 viewDir = normalize(-vs_Position);
-
-    // blinn phong
-    vec3 halfDir = normalize(lightDir + viewDir);
-    float specAngle = max(dot(halfDir, normal), 0.0);
-    specular = pow(specAngle, shininess);
-  }
-  vec3 colorLinear = ambientColor +
-                     diffuseColor * lambertian * lightColor * lightPower / distance +
-                     specColor * specular * lightColor * lightPower / distance;
-
-  vec3 colorGammaCorrected = pow(colorLinear, vec3(1.0/screenGamma));
-  color = vec4(colorLinear, 1.0);
-
-  color = vec4(colorGammaCorrected, 1.0);
-}
\ No newline at end of file
+#include "fragment.glsl"
\ No newline at end of file
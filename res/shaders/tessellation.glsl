@@ -0,0 +1,122 @@
+#shader vertex
+#version 450
+
+layout(location = 0) in vec2 cell;  // Patch corner on the height texture grid
+out vec2 vs_Cell;
+
+void main()
+{
+    vs_Cell = cell;
+}
+
+#shader tess_control
+#version 450
+
+layout(vertices = 4) out;
+in vec2 vs_Cell[];
+out vec2 tc_Cell[];
+layout(location = 4) uniform float maxH;
+layout(location = 5) uniform float minH;
+layout(location = 7) uniform int gridSize;
+layout(location = 8) uniform bool heightQuantized;
+layout(location = 11) uniform vec3 eye;           // Camera in model space
+layout(location = 12) uniform float pixelsPerUnit; // Pixels a unit length covers at distance 1
+layout(location = 13) uniform float pixelsPerEdge; // Target length of a tessellated edge
+layout(binding = 0) uniform sampler2D heightMap;
+
+vec3 cornerPosition(vec2 cell)
+{
+    float spacing = 2.0/float(gridSize - 1);
+    float h = texelFetch(heightMap, ivec2(cell), 0).r;
+    h = heightQuantized ? minH + h*(maxH - minH) : h;
+    return vec3(cell.x*spacing - 1.0, 1.0 - cell.y*spacing, h);
+}
+
+// Segments for an edge, from the pixels it covers seen from its midpoint.
+// Both patches sharing an edge compute the same value, so they meet
+// without cracks.
+float edgeLevel(vec3 a, vec3 b)
+{
+    float d = max(distance(eye, 0.5*(a + b)), 1e-4);
+    return clamp(distance(a, b)*pixelsPerUnit/(d*pixelsPerEdge), 1.0, 64.0);
+}
+
+void main()
+{
+    tc_Cell[gl_InvocationID] = vs_Cell[gl_InvocationID];
+    if(gl_InvocationID == 0)
+    {
+        // Corners are (x0, y0), (x1, y0), (x1, y1), (x0, y1)
+        vec3 p0 = cornerPosition(vs_Cell[0]);
+        vec3 p1 = cornerPosition(vs_Cell[1]);
+        vec3 p2 = cornerPosition(vs_Cell[2]);
+        vec3 p3 = cornerPosition(vs_Cell[3]);
+        gl_TessLevelOuter[0] = edgeLevel(p0, p3);   // u = 0
+        gl_TessLevelOuter[1] = edgeLevel(p0, p1);   // v = 0
+        gl_TessLevelOuter[2] = edgeLevel(p1, p2);   // u = 1
+        gl_TessLevelOuter[3] = edgeLevel(p3, p2);   // v = 1
+        gl_TessLevelInner[0] = max(gl_TessLevelOuter[1], gl_TessLevelOuter[3]);
+        gl_TessLevelInner[1] = max(gl_TessLevelOuter[0], gl_TessLevelOuter[2]);
+    }
+}
+
+#shader tess_evaluation
+#version 450
+
+// Grid y runs down the texture and model y up, so counter-clockwise in the
+// patch is clockwise in model space like the other render modes
+layout(quads, fractional_even_spacing, ccw) in;
+in vec2 tc_Cell[];
+layout(location = 2) uniform mat4 projection;
+out float c;
+out vec3 vs_Position;
+out vec3 vs_Normal;
+out float time;
+layout(location = 3) uniform float t;
+layout(location = 4) uniform float maxH;
+layout(location = 5) uniform float minH;
+layout(location = 7) uniform int gridSize;
+layout(location = 8) uniform bool heightQuantized;
+layout(location = 9) uniform vec2 gridOffset;
+layout(binding = 0) uniform sampler2D heightMap;
+
+float height(int x, int y)
+{
+    float h = texelFetch(heightMap, clamp(ivec2(x, y), ivec2(0), ivec2(gridSize - 1)), 0).r;
+    return heightQuantized ? minH + h*(maxH - minH) : h;
+}
+
+// Tessellated vertices fall between texels, heights are bilinear
+float bilinearHeight(vec2 cell)
+{
+    cell = clamp(cell, vec2(0.0), vec2(float(gridSize - 1)));
+    ivec2 i = min(ivec2(cell), ivec2(gridSize - 2));
+    vec2 f = cell - vec2(i);
+    float top = mix(height(i.x, i.y), height(i.x + 1, i.y), f.x);
+    float bottom = mix(height(i.x, i.y + 1), height(i.x + 1, i.y + 1), f.x);
+    return mix(top, bottom, f.y);
+}
+
+void main()
+{
+    float spacing = 2.0/float(gridSize - 1);
+    vec2 u = gl_TessCoord.xy;
+    vec2 cell = mix(mix(tc_Cell[0], tc_Cell[1], u.x), mix(tc_Cell[3], tc_Cell[2], u.x), u.y);
+    vec4 newPosition = vec4(gridOffset + vec2(cell.x*spacing - 1.0, 1.0 - cell.y*spacing), bilinearHeight(cell), 1.0);
+
+    // Central differences as textureNormal in render.glsl, taken over the
+    // tessellated vertex spacing so coarse patches are not lit by detail
+    // their geometry lacks
+    vec2 step = max(abs(tc_Cell[2] - tc_Cell[0])/vec2(gl_TessLevelInner[0], gl_TessLevelInner[1]), vec2(1.0));
+    float nx = (bilinearHeight(cell - vec2(step.x, 0.0)) - bilinearHeight(cell + vec2(step.x, 0.0)))/step.x;
+    float ny = (bilinearHeight(cell + vec2(0.0, step.y)) - bilinearHeight(cell - vec2(0.0, step.y)))/step.y;
+
+    gl_Position = projection * newPosition;
+    c = clamp( (newPosition.z-minH)/(maxH-minH) , 0.0, 1.0);
+    vs_Position = newPosition.xyz;
+    vs_Normal = normalize(vec3(nx, ny, 2.0*spacing));
+    time = t;
+}
+
+#shader fragment
+#include "fragment.glsl"
\ No newline at end of file
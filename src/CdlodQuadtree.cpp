@@ -0,0 +1,210 @@
+/*
+ * Copyright (c) 2018 Brendan Barnes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#include "CdlodQuadtree.h"
+#include <cmath>
+
+// Share of each LOD's range over which its vertices morph into the next
+static const float MORPH_START_RATIO = 0.66f;
+
+CdlodQuadtree::CdlodQuadtree()
+    : mGridSize(0), mPatchSize(0), mSpacing(0.0f)
+{
+
+}
+
+void CdlodQuadtree::Build(const HeightField& map, const int patchSize, const unsigned int threadCount)
+{
+    const int n = map.GetWidth();
+    mGridSize = n;
+    mPatchSize = patchSize;
+    mSpacing = 2.0f/(float)(n - 1);
+    mLevels.clear();
+
+    // Leaves cover patchSize quads, so (patchSize + 1)^2 vertices each
+    Level leaves;
+    leaves.nodesPerSide = (n - 1)/patchSize;
+    ComputeTileBounds(map, patchSize, leaves.bounds, threadCount);
+    mLevels.push_back(std::move(leaves));
+
+    // Each parent spans its four children
+    while(mLevels.back().nodesPerSide > 1)
+    {
+        const Level& children = mLevels.back();
+        Level parents;
+        parents.nodesPerSide = children.nodesPerSide/2;
+        parents.bounds.resize((size_t)parents.nodesPerSide*parents.nodesPerSide);
+        for(int y = 0; y < parents.nodesPerSide; y++)
+        {
+            for(int x = 0; x < parents.nodesPerSide; x++)
+            {
+                ElevationBounds bounds = children.bounds[(size_t)2*y*children.nodesPerSide + 2*x];
+                for(int k = 1; k < 4; k++)
+                {
+                    const ElevationBounds& child = children.bounds[(size_t)(2*y + k/2)*children.nodesPerSide + 2*x + k%2];
+                    bounds.minElevation = child.minElevation < bounds.minElevation ? child.minElevation : bounds.minElevation;
+                    bounds.maxElevation = child.maxElevation > bounds.maxElevation ? child.maxElevation : bounds.maxElevation;
+                }
+                parents.bounds[(size_t)y*parents.nodesPerSide + x] = bounds;
+            }
+        }
+        mLevels.push_back(std::move(parents));
+    }
+    mRanges.assign(mLevels.size(), 0.0f);
+}
+
+void CdlodQuadtree::Clear()
+{
+    mLevels.clear();
+    mRanges.clear();
+    mGridSize = 0;
+}
+
+size_t CdlodQuadtree::GetSizeInBytes() const
+{
+    size_t bytes = 0;
+    for(size_t i = 0; i < mLevels.size(); i++)
+    {
+        bytes += mLevels[i].bounds.size()*sizeof(ElevationBounds);
+    }
+    return bytes;
+}
+
+void CdlodQuadtree::SetLodRanges(float finestRange)
+{
+    // Neighbouring nodes may only differ by one LOD, which needs every
+    // range to reach past a couple of its nodes
+    const float minimum = 2.0f*mPatchSize*mSpacing;
+    finestRange = finestRange > minimum ? finestRange : minimum;
+    for(size_t lod = 0; lod < mRanges.size(); lod++)
+    {
+        mRanges[lod] = finestRange*(float)(1 << lod);
+    }
+}
+
+float CdlodQuadtree::GetFinestRangeFor(const float pixelsPerQuad, const float viewportHeight, const float fovY) const
+{
+    // A length l at distance d covers l*viewportHeight/(2*d*tan(fovY/2)) pixels
+    const float halfAngle = 0.5f*fovY*(float)M_PI/180.0f;
+    return mSpacing*viewportHeight/(2.0f*tanf(halfAngle)*pixelsPerQuad);
+}
+
+void CdlodQuadtree::GetBox(const int lod, const int x, const int y, vmath::vec3& boxMin, vmath::vec3& boxMax) const
+{
+    const Level& level = mLevels[lod];
+    const ElevationBounds& bounds = level.bounds[(size_t)y*level.nodesPerSide + x];
+    const float size = (float)(mPatchSize << lod)*mSpacing;
+    boxMin = vmath::vec3(x*size - 1.0f, 1.0f - (y + 1)*size, bounds.minElevation);
+    boxMax = vmath::vec3((x + 1)*size - 1.0f, 1.0f - y*size, bounds.maxElevation);
+}
+
+// Whether any point of the box is within radius of center
+static bool BoxIntersectsSphere(const vmath::vec3& boxMin, const vmath::vec3& boxMax, const vmath::vec3& center, const float radius)
+{
+    float distance = 0.0f;
+    for(int i = 0; i < 3; i++)
+    {
+        float d = center[i] < boxMin[i] ? boxMin[i] - center[i] : (center[i] > boxMax[i] ? center[i] - boxMax[i] : 0.0f);
+        distance += d*d;
+    }
+    return distance <= radius*radius;
+}
+
+void CdlodQuadtree::Select(const vmath::vec3& eye, const Frustum& frustum, CdlodSelection& selection) const
+{
+    selection.nodes.clear();
+    selection.quarterNodes.clear();
+    selection.stats = CdlodStats();
+    if(mLevels.empty())
+    {
+        return;
+    }
+    SelectNode((int)mLevels.size() - 1, 0, 0, eye, frustum, selection);
+    const size_t patchTriangles = 2*(size_t)mPatchSize*mPatchSize;
+    selection.stats.selectedNodes = (int)(selection.nodes.size() + selection.quarterNodes.size());
+    selection.stats.triangles = selection.nodes.size()*patchTriangles + selection.quarterNodes.size()*patchTriangles/4;
+}
+
+bool CdlodQuadtree::SelectNode(const int lod, const int x, const int y, const vmath::vec3& eye, const Frustum& frustum,
+    CdlodSelection& selection) const
+{
+    vmath::vec3 boxMin, boxMax;
+    GetBox(lod, x, y, boxMin, boxMax);
+    // The root covers whatever is left beyond every range
+    const int top = (int)mLevels.size() - 1;
+    if(lod < top && !BoxIntersectsSphere(boxMin, boxMax, eye, mRanges[lod]))
+    {
+        return false;
+    }
+    if(!frustum.Intersects(boxMin, boxMax))
+    {
+        selection.stats.culledNodes++;
+        return true;
+    }
+
+    const float size = (float)(mPatchSize << lod);
+    if(lod == 0 || !BoxIntersectsSphere(boxMin, boxMax, eye, mRanges[lod-1]))
+    {
+        selection.nodes.push_back(MakeNode(lod, x*size, y*size, size));
+        return true;
+    }
+
+    // Children out of the finer range are drawn at this LOD
+    for(int k = 0; k < 4; k++)
+    {
+        const int cx = 2*x + k%2;
+        const int cy = 2*y + k/2;
+        if(!SelectNode(lod - 1, cx, cy, eye, frustum, selection))
+        {
+            vmath::vec3 childMin, childMax;
+            GetBox(lod - 1, cx, cy, childMin, childMax);
+            if(!frustum.Intersects(childMin, childMax))
+            {
+                selection.stats.culledNodes++;
+                continue;
+            }
+            selection.quarterNodes.push_back(MakeNode(lod, cx*size*0.5f, cy*size*0.5f, size*0.5f));
+        }
+    }
+    return true;
+}
+
+CdlodNode CdlodQuadtree::MakeNode(const int lod, const float x, const float y, const float size) const
+{
+    CdlodNode node;
+    node.x = x;
+    node.y = y;
+    node.size = size;
+    node.lod = (float)lod;
+    if(lod == (int)mLevels.size() - 1)
+    {
+        // Nothing coarser to morph into
+        node.morphStart = 1e30f;
+        node.morphEnd = 2e30f;
+        return node;
+    }
+    const float previous = lod > 0 ? mRanges[lod-1] : 0.0f;
+    node.morphStart = previous + (mRanges[lod] - previous)*MORPH_START_RATIO;
+    // Finish just inside the range so the seam with the next LOD is exact
+    node.morphEnd = mRanges[lod] + (node.morphStart - mRanges[lod])*0.01f;
+    return node;
+}
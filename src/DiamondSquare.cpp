@@ -0,0 +1,361 @@
+/*
+ * Copyright (c) 2018 Brendan Barnes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "DiamondSquare.h"
+#include "ThreadPool.h"
+#include <cstring>
+#include <iostream>
+#include <mutex>
+
+DiamondSquare::DiamondSquare()
+    : mThreadCount(0), mSimdLevel(GetBestSimdLevel()), mTileSize(256), mBlockingDetailLevel(13),
+      mMinElevation(0.0f), mMaxElevation(0.0f), mProgress(nullptr)
+{
+
+}
+
+void DiamondSquare::Generate(HeightField& map, const unsigned char detailLevel, float range, const uint32_t seed)
+{
+    const int n = (1 << detailLevel) + 1;   // DEM length
+    mMinElevation = 0.0f;                   // DEM min elevation
+    mMaxElevation = 0.0f;                   // DEM max elevation
+    map.Allocate(n, n);                     // Every cell is written exactly once below
+    ReportProgress(0.0f);
+
+    // Set corners
+    map(0, 0) = 0.0f;
+    map(0, n-1) = 0.0f;
+    map(n-1, 0) = 0.0f;
+    map(n-1, n-1) = 0.0f;
+
+    const DiamondSquareKernels& kernels = GetDiamondSquareKernels(mSimdLevel);
+    std::mutex reduceMutex;
+
+    // Large maps finish their last levels tile by tile instead of sweeping
+    const bool blocked = mTileSize > 0 && detailLevel >= mBlockingDetailLevel && n-1 >= mTileSize;
+
+    // Random offsets are keyed on (seed, level, x, y) where level is
+    // log2(sideLength), so the result only depends on the seed.
+    for(int sideLength = n-1, level = detailLevel; sideLength >= 2; sideLength /= 2, range /= 2, level--)
+    {
+        if(blocked && sideLength == BLOCKED_SIDE_LENGTH)
+        {
+            GenerateTiles(kernels, map, range, seed);
+            break;
+        }
+
+        const int halfSide = sideLength/2;
+        const uint32_t levelKey = HashLevelKey(seed, level);
+
+        // Diamond step
+        ThreadPool::SharedParallelFor((n-1)/sideLength, mThreadCount, [&](int first, int last)
+        {
+            float lo = 0.0f, hi = 0.0f;
+            DiamondRows(kernels, map, sideLength, range, levelKey, first, last, lo, hi);
+            std::lock_guard<std::mutex> lock(reduceMutex);
+            mMinElevation = lo < mMinElevation ? lo : mMinElevation;
+            mMaxElevation = hi > mMaxElevation ? hi : mMaxElevation;
+        });
+        // Square step
+        ThreadPool::SharedParallelFor((n-1)/halfSide, mThreadCount, [&](int first, int last)
+        {
+            float lo = 0.0f, hi = 0.0f;
+            SquareRows(kernels, map, sideLength, range, levelKey, first, last, lo, hi);
+            std::lock_guard<std::mutex> lock(reduceMutex);
+            mMinElevation = lo < mMinElevation ? lo : mMinElevation;
+            mMaxElevation = hi > mMaxElevation ? hi : mMaxElevation;
+        });
+        // Every cell on a grid of sideLength/2 is now final
+        ReportProgress(4.0f/((float)sideLength*sideLength));
+        if(mLevelCallback)
+        {
+            mLevelCallback(map, sideLength);
+        }
+    }
+}
+
+void DiamondSquare::GenerateInterior(HeightField& map, const unsigned char detailLevel, float range, const uint32_t seed)
+{
+    const int n = (1 << detailLevel) + 1;   // DEM length
+    if(map.GetWidth() != n || map.GetHeight() != n)
+    {
+        std::cout << "GenerateInterior: map is not " << n << "x" << n << std::endl;
+        return;
+    }
+    ReportProgress(0.0f);
+
+    // The border counts towards the elevation range
+    mMinElevation = map(0, 0);
+    mMaxElevation = map(0, 0);
+    for(int i = 0; i < n; i++)
+    {
+        const float border[4] = {map(i, 0), map(i, n-1), map(0, i), map(n-1, i)};
+        for(int k = 0; k < 4; k++)
+        {
+            mMinElevation = border[k] < mMinElevation ? border[k] : mMinElevation;
+            mMaxElevation = border[k] > mMaxElevation ? border[k] : mMaxElevation;
+        }
+    }
+
+    const float start = map(0, 0);          // Inside the range, seeds each band's min/max
+    const DiamondSquareKernels& kernels = GetDiamondSquareKernels(mSimdLevel);
+    std::mutex reduceMutex;
+
+    // Same passes and random keys as Generate, minus the wrap around
+    for(int sideLength = n-1, level = detailLevel; sideLength >= 2; sideLength /= 2, range /= 2, level--)
+    {
+        const int halfSide = sideLength/2;
+        const uint32_t levelKey = HashLevelKey(seed, level);
+
+        // Diamond step, every centre is inside the border
+        ThreadPool::SharedParallelFor((n-1)/sideLength, mThreadCount, [&](int first, int last)
+        {
+            float lo = start, hi = start;
+            DiamondRows(kernels, map, sideLength, range, levelKey, first, last, lo, hi);
+            std::lock_guard<std::mutex> lock(reduceMutex);
+            mMinElevation = lo < mMinElevation ? lo : mMinElevation;
+            mMaxElevation = hi > mMaxElevation ? hi : mMaxElevation;
+        });
+        // Square step, skipping rows 0 and n-1
+        ThreadPool::SharedParallelFor((n-1)/halfSide - 1, mThreadCount, [&](int first, int last)
+        {
+            float lo = start, hi = start;
+            InteriorSquareRows(kernels, map, sideLength, range, levelKey, first, last, lo, hi);
+            std::lock_guard<std::mutex> lock(reduceMutex);
+            mMinElevation = lo < mMinElevation ? lo : mMinElevation;
+            mMaxElevation = hi > mMaxElevation ? hi : mMaxElevation;
+        });
+        ReportProgress(4.0f/((float)sideLength*sideLength));
+    }
+}
+
+void DiamondSquare::DiamondRows(const DiamondSquareKernels& kernels, HeightField& map, const int sideLength, const float range,
+    const uint32_t levelKey, const int first, const int last, float& minElevation, float& maxElevation)
+{
+    const int n = map.GetWidth();
+    const int halfSide = sideLength/2;
+    for(int y = first*sideLength; y < last*sideLength; y += sideLength)
+    {
+        const uint32_t rowKey = HashRowKey(levelKey, y+halfSide);
+        kernels.Diamond(map.Row(y), map.Row(y+sideLength), map.Row(y+halfSide),
+            halfSide, (n-1)/sideLength, sideLength, rowKey, 0, range, minElevation, maxElevation);
+    }
+}
+
+void DiamondSquare::SquareRows(const DiamondSquareKernels& kernels, HeightField& map, const int sideLength, const float range,
+    const uint32_t levelKey, const int first, const int last, float& minElevation, float& maxElevation)
+{
+    const int n = map.GetWidth();
+    const int halfSide = sideLength/2;
+    for(int y = first*halfSide; y < last*halfSide; y += halfSide)
+    {
+        // The map wraps around, row and column n-1 mirror row and column 0
+        const float* up = map.Row((y-halfSide+n-1)%(n-1));
+        const float* down = map.Row((y+halfSide)%(n-1));
+        float* row = map.Row(y);
+        const uint32_t rowKey = HashRowKey(levelKey, y);
+        int x0 = (y+halfSide)%sideLength;
+        if(x0 == 0)
+        {
+            float offset = HashToRange(HashCell(rowKey, 0), -range, range);
+            float value = SquareCell(up[0], down[0], row[halfSide], row[n-1-halfSide], offset);
+            row[0] = value;
+            row[n-1] = value;
+            minElevation = value < minElevation ? value : minElevation;
+            maxElevation = value > maxElevation ? value : maxElevation;
+            x0 = sideLength;
+        }
+        kernels.Square(up, down, row, x0, (n-1-x0 + sideLength-1)/sideLength, sideLength, rowKey, 0, range, minElevation, maxElevation);
+
+        if(y == 0)
+        {
+            float* mirror = map.Row(n-1);
+            for(int x = halfSide; x < n-1; x += sideLength)
+            {
+                mirror[x] = row[x];
+            }
+        }
+    }
+}
+
+void DiamondSquare::InteriorSquareRows(const DiamondSquareKernels& kernels, HeightField& map, const int sideLength, const float range,
+    const uint32_t levelKey, const int first, const int last, float& minElevation, float& maxElevation)
+{
+    const int n = map.GetWidth();
+    const int halfSide = sideLength/2;
+    for(int y = (first+1)*halfSide; y < (last+1)*halfSide; y += halfSide)
+    {
+        // Rows between two diamond rows start on the border, which is skipped
+        const bool cornerRow = y%sideLength == 0;
+        const int x0 = cornerRow ? halfSide : sideLength;
+        const int count = cornerRow ? (n-1)/sideLength : (n-1)/sideLength - 1;
+        if(count > 0)
+        {
+            kernels.Square(map.Row(y-halfSide), map.Row(y+halfSide), map.Row(y), x0, count, sideLength,
+                HashRowKey(levelKey, y), 0, range, minElevation, maxElevation);
+        }
+    }
+}
+
+// Global column or row g of a map that repeats every period cells
+static inline int Wrap(int g, int period)
+{
+    return g < 0 ? g + period : (g >= period ? g - period : g);
+}
+
+// Run the cells x0, x0 + step, ... of a window row through fn in runs that
+// don't cross the wrap seam. Window column 0 is global column ox and fn gets
+// the key offset that maps a window column to its wrapped global column.
+template <typename Func>
+static void ForEachRun(int ox, int x0, int count, int step, int period, Func fn)
+{
+    int k = 0;
+    while(k < count)
+    {
+        const int g = ox + x0 + k*step;
+        const int wrapOffset = g < 0 ? period : (g >= period ? -period : 0);
+        int run = count - k;
+        if(wrapOffset != -period)
+        {
+            // Cells up to the next seam share the offset
+            const int seam = wrapOffset == period ? 0 : period;
+            const int seamRun = (seam - g + step - 1)/step;
+            run = seamRun < run ? seamRun : run;
+        }
+        fn(x0 + k*step, run, ox + wrapOffset);
+        k += run;
+    }
+}
+
+void DiamondSquare::GenerateTiles(const DiamondSquareKernels& kernels, HeightField& map, const float range, const uint32_t seed)
+{
+    const int n = map.GetWidth();
+    const int tilesPerSide = (n-1)/mTileSize;
+    const int tileCount = tilesPerSide*tilesPerSide;
+    const float startProgress = 4.0f/((float)BLOCKED_SIDE_LENGTH*2*BLOCKED_SIDE_LENGTH*2);
+    std::atomic<int> tilesDone(0);
+    std::mutex reduceMutex;
+
+    ThreadPool::SharedParallelFor(tileCount, mThreadCount, [&](int first, int last)
+    {
+        // Scratch window reused by every tile of the band
+        HeightField window;
+        window.Allocate(mTileSize + 2*BLOCKED_SIDE_LENGTH + 1, mTileSize + 2*BLOCKED_SIDE_LENGTH + 1);
+        float lo = 0.0f, hi = 0.0f;
+        for(int tile = first; tile < last; tile++)
+        {
+            GenerateTile(kernels, map, window, (tile%tilesPerSide)*mTileSize, (tile/tilesPerSide)*mTileSize, range, seed, lo, hi);
+            RaiseProgress(startProgress + (1.0f - startProgress)*(float)(++tilesDone)/(float)tileCount);
+        }
+        std::lock_guard<std::mutex> lock(reduceMutex);
+        mMinElevation = lo < mMinElevation ? lo : mMinElevation;
+        mMaxElevation = hi > mMaxElevation ? hi : mMaxElevation;
+    });
+
+    // Row and column n-1 mirror row and column 0
+    float* mirror = map.Row(n-1);
+    const float* row = map.Row(0);
+    for(int x = 0; x < n; x++)
+    {
+        mirror[x] = row[x];
+    }
+    for(int y = 0; y < n; y++)
+    {
+        float* cells = map.Row(y);
+        cells[n-1] = cells[0];
+    }
+}
+
+void DiamondSquare::GenerateTile(const DiamondSquareKernels& kernels, HeightField& map, HeightField& window,
+    const int tileX, const int tileY, float range, const uint32_t seed, float& minElevation, float& maxElevation)
+{
+    // The window holds the tile plus a halo of one coarse cell on each side.
+    // Halo cells are recomputed rather than shared with the neighbouring
+    // tiles. The pass with sideLength s only computes cells at least
+    // top - s/2 inside the window, which is exactly the cone of cells the
+    // tile depends on, so every computed cell matches the full sweep and the
+    // kernels' min/max stay exact.
+    const int n = map.GetWidth();
+    const int period = n-1;
+    const int top = BLOCKED_SIDE_LENGTH;
+    const int ox = tileX - top;
+    const int oy = tileY - top;
+    const int last = window.GetWidth() - 1;
+
+    // Seed the window with the finished coarse lattice
+    for(int wy = 0; wy <= last; wy += top)
+    {
+        const float* src = map.Row(Wrap(oy + wy, period));
+        float* dst = window.Row(wy);
+        for(int wx = 0; wx <= last; wx += top)
+        {
+            dst[wx] = src[Wrap(ox + wx, period)];
+        }
+    }
+
+    int level = 0;
+    while((1 << level) < top)
+    {
+        level++;
+    }
+    for(int sideLength = top; sideLength >= 2; sideLength /= 2, range /= 2, level--)
+    {
+        const int halfSide = sideLength/2;
+        const int margin = top - halfSide;  // Odd multiple of halfSide
+        const uint32_t levelKey = HashLevelKey(seed, level);
+
+        // Diamond step
+        for(int wy = margin - halfSide; wy + sideLength <= last - margin + halfSide; wy += sideLength)
+        {
+            const uint32_t rowKey = HashRowKey(levelKey, Wrap(oy + wy + halfSide, period));
+            const float* upper = window.Row(wy);
+            const float* lower = window.Row(wy + sideLength);
+            float* center = window.Row(wy + halfSide);
+            ForEachRun(ox, margin, (last - 2*margin)/sideLength + 1, sideLength, period, [&](int x0, int count, int keyOffset)
+            {
+                kernels.Diamond(upper, lower, center, x0, count, sideLength, rowKey, keyOffset, range, minElevation, maxElevation);
+            });
+        }
+        // Square step
+        for(int wy = margin; wy <= last - margin; wy += halfSide)
+        {
+            const uint32_t rowKey = HashRowKey(levelKey, Wrap(oy + wy, period));
+            const float* up = window.Row(wy - halfSide);
+            const float* down = window.Row(wy + halfSide);
+            float* row = window.Row(wy);
+            const bool cornerRow = wy%sideLength == 0;
+            const int x0 = cornerRow ? margin : margin + halfSide;
+            const int count = cornerRow ? (last - 2*margin)/sideLength + 1 : (last - 2*margin - sideLength)/sideLength + 1;
+            ForEachRun(ox, x0, count, sideLength, period, [&](int first, int cells, int keyOffset)
+            {
+                kernels.Square(up, down, row, first, cells, sideLength, rowKey, keyOffset, range, minElevation, maxElevation);
+            });
+        }
+    }
+
+    // Copy the tile back
+    for(int y = 0; y < mTileSize; y++)
+    {
+        memcpy(map.Row(tileY + y) + tileX, window.Row(top + y) + top, mTileSize*sizeof(float));
+    }
+}
@@ -0,0 +1,315 @@
+/*
+ * Copyright (c) 2018 Brendan Barnes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "DiamondSquareKernels.h"
+
+#ifdef TERRAIN_X86
+#include <immintrin.h>
+#endif
+
+//-----Scalar-----//
+
+static void DiamondRowScalar(const float* top, const float* bottom, float* center,
+    int x0, int count, int sideLength, uint32_t rowKey, int keyOffset, float range, float& lo, float& hi)
+{
+    const int halfSide = sideLength/2;
+    for(int k = 0, x = x0; k < count; k++, x += sideLength)
+    {
+        float offset = HashToRange(HashCell(rowKey, x + keyOffset), -range, range);
+        float value = DiamondCell(top[x-halfSide], top[x+halfSide], bottom[x-halfSide], bottom[x+halfSide], offset);
+        center[x] = value;
+        if(value < lo)
+        {
+            lo = value;
+        }
+        else if(value > hi)
+        {
+            hi = value;
+        }
+    }
+}
+
+static void SquareRowScalar(const float* up, const float* down, float* row,
+    int x0, int count, int sideLength, uint32_t rowKey, int keyOffset, float range, float& lo, float& hi)
+{
+    const int halfSide = sideLength/2;
+    for(int k = 0, x = x0; k < count; k++, x += sideLength)
+    {
+        float offset = HashToRange(HashCell(rowKey, x + keyOffset), -range, range);
+        float value = SquareCell(up[x], down[x], row[x+halfSide], row[x-halfSide], offset);
+        row[x] = value;
+        if(value < lo)
+        {
+            lo = value;
+        }
+        else if(value > hi)
+        {
+            hi = value;
+        }
+    }
+}
+
+#ifdef TERRAIN_X86
+
+//-----SSE4.1-----//
+// Four cells per iteration. SSE has no gather, strided loads are assembled
+// lane by lane.
+
+__attribute__((target("sse4.1")))
+static inline __m128 LoadStridedSSE(const float* p, int stride)
+{
+    return _mm_setr_ps(p[0], p[stride], p[2*stride], p[3*stride]);
+}
+
+__attribute__((target("sse4.1")))
+static inline void StoreStridedSSE(float* p, int stride, __m128 v)
+{
+    alignas(16) float lanes[4];
+    _mm_store_ps(lanes, v);
+    p[0] = lanes[0];
+    p[stride] = lanes[1];
+    p[2*stride] = lanes[2];
+    p[3*stride] = lanes[3];
+}
+
+// Vector form of HashToRange(HashCell(rowKey, x + keyOffset), fMin, fMin + span)
+__attribute__((target("sse4.1")))
+static inline __m128 RandomRangeSSE(__m128i rowKey, __m128i x, __m128 fMin, __m128 span)
+{
+    __m128i h = _mm_xor_si128(rowKey, x);
+    h = _mm_xor_si128(h, _mm_srli_epi32(h, 16));
+    h = _mm_mullo_epi32(h, _mm_set1_epi32(0x7feb352d));
+    h = _mm_xor_si128(h, _mm_srli_epi32(h, 15));
+    h = _mm_mullo_epi32(h, _mm_set1_epi32((int)0x846ca68bU));
+    h = _mm_xor_si128(h, _mm_srli_epi32(h, 16));
+    __m128 f = _mm_mul_ps(_mm_cvtepi32_ps(_mm_srli_epi32(h, 8)), _mm_set1_ps(1.0f/16777216.0f));
+    return _mm_add_ps(fMin, _mm_mul_ps(f, span));
+}
+
+__attribute__((target("sse4.1")))
+static void ReduceMinMaxSSE(__m128 vlo, __m128 vhi, float& lo, float& hi)
+{
+    alignas(16) float lanes[4];
+    _mm_store_ps(lanes, vlo);
+    for(int i = 0; i < 4; i++)
+    {
+        lo = lanes[i] < lo ? lanes[i] : lo;
+    }
+    _mm_store_ps(lanes, vhi);
+    for(int i = 0; i < 4; i++)
+    {
+        hi = lanes[i] > hi ? lanes[i] : hi;
+    }
+}
+
+__attribute__((target("sse4.1")))
+static void DiamondRowSSE(const float* top, const float* bottom, float* center,
+    int x0, int count, int sideLength, uint32_t rowKey, int keyOffset, float range, float& lo, float& hi)
+{
+    const int halfSide = sideLength/2;
+    const __m128i key = _mm_set1_epi32((int)rowKey);
+    const __m128i lanes = _mm_mullo_epi32(_mm_setr_epi32(0, 1, 2, 3), _mm_set1_epi32(sideLength));
+    const __m128 fMin = _mm_set1_ps(-range);
+    const __m128 span = _mm_set1_ps(range - -range);
+    const __m128 quarter = _mm_set1_ps(0.25f);
+    __m128 vlo = _mm_set1_ps(lo);
+    __m128 vhi = _mm_set1_ps(hi);
+    int k = 0;
+    for(; k + 4 <= count; k += 4)
+    {
+        const int x = x0 + k*sideLength;
+        __m128 avg = _mm_add_ps(LoadStridedSSE(top + x - halfSide, sideLength), LoadStridedSSE(top + x + halfSide, sideLength));
+        avg = _mm_add_ps(avg, LoadStridedSSE(bottom + x - halfSide, sideLength));
+        avg = _mm_add_ps(avg, LoadStridedSSE(bottom + x + halfSide, sideLength));
+        avg = _mm_mul_ps(avg, quarter);
+        __m128 offset = RandomRangeSSE(key, _mm_add_epi32(_mm_set1_epi32(x + keyOffset), lanes), fMin, span);
+        __m128 value = _mm_add_ps(avg, offset);
+        StoreStridedSSE(center + x, sideLength, value);
+        vlo = _mm_min_ps(value, vlo);
+        vhi = _mm_max_ps(value, vhi);
+    }
+    ReduceMinMaxSSE(vlo, vhi, lo, hi);
+    DiamondRowScalar(top, bottom, center, x0 + k*sideLength, count - k, sideLength, rowKey, keyOffset, range, lo, hi);
+}
+
+__attribute__((target("sse4.1")))
+static void SquareRowSSE(const float* up, const float* down, float* row,
+    int x0, int count, int sideLength, uint32_t rowKey, int keyOffset, float range, float& lo, float& hi)
+{
+    const int halfSide = sideLength/2;
+    const __m128i key = _mm_set1_epi32((int)rowKey);
+    const __m128i lanes = _mm_mullo_epi32(_mm_setr_epi32(0, 1, 2, 3), _mm_set1_epi32(sideLength));
+    const __m128 fMin = _mm_set1_ps(-range);
+    const __m128 span = _mm_set1_ps(range - -range);
+    const __m128 four = _mm_set1_ps(4.0f);
+    __m128 vlo = _mm_set1_ps(lo);
+    __m128 vhi = _mm_set1_ps(hi);
+    int k = 0;
+    for(; k + 4 <= count; k += 4)
+    {
+        const int x = x0 + k*sideLength;
+        __m128 sum = _mm_add_ps(LoadStridedSSE(up + x, sideLength), LoadStridedSSE(down + x, sideLength));
+        sum = _mm_add_ps(sum, LoadStridedSSE(row + x + halfSide, sideLength));
+        sum = _mm_add_ps(sum, LoadStridedSSE(row + x - halfSide, sideLength));
+        __m128 offset = RandomRangeSSE(key, _mm_add_epi32(_mm_set1_epi32(x + keyOffset), lanes), fMin, span);
+        __m128 value = _mm_div_ps(sum, _mm_add_ps(four, offset));
+        StoreStridedSSE(row + x, sideLength, value);
+        vlo = _mm_min_ps(value, vlo);
+        vhi = _mm_max_ps(value, vhi);
+    }
+    ReduceMinMaxSSE(vlo, vhi, lo, hi);
+    SquareRowScalar(up, down, row, x0 + k*sideLength, count - k, sideLength, rowKey, keyOffset, range, lo, hi);
+}
+
+//-----AVX2-----//
+// Eight cells per iteration with hardware gathers for the strided loads.
+
+__attribute__((target("avx2")))
+static inline void StoreStridedAVX2(float* p, int stride, __m256 v)
+{
+    alignas(32) float lanes[8];
+    _mm256_store_ps(lanes, v);
+    for(int i = 0; i < 8; i++)
+    {
+        p[i*stride] = lanes[i];
+    }
+}
+
+__attribute__((target("avx2")))
+static inline __m256 RandomRangeAVX2(__m256i rowKey, __m256i x, __m256 fMin, __m256 span)
+{
+    __m256i h = _mm256_xor_si256(rowKey, x);
+    h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 16));
+    h = _mm256_mullo_epi32(h, _mm256_set1_epi32(0x7feb352d));
+    h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 15));
+    h = _mm256_mullo_epi32(h, _mm256_set1_epi32((int)0x846ca68bU));
+    h = _mm256_xor_si256(h, _mm256_srli_epi32(h, 16));
+    __m256 f = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srli_epi32(h, 8)), _mm256_set1_ps(1.0f/16777216.0f));
+    return _mm256_add_ps(fMin, _mm256_mul_ps(f, span));
+}
+
+__attribute__((target("avx2")))
+static void ReduceMinMaxAVX2(__m256 vlo, __m256 vhi, float& lo, float& hi)
+{
+    alignas(32) float lanes[8];
+    _mm256_store_ps(lanes, vlo);
+    for(int i = 0; i < 8; i++)
+    {
+        lo = lanes[i] < lo ? lanes[i] : lo;
+    }
+    _mm256_store_ps(lanes, vhi);
+    for(int i = 0; i < 8; i++)
+    {
+        hi = lanes[i] > hi ? lanes[i] : hi;
+    }
+}
+
+__attribute__((target("avx2")))
+static void DiamondRowAVX2(const float* top, const float* bottom, float* center,
+    int x0, int count, int sideLength, uint32_t rowKey, int keyOffset, float range, float& lo, float& hi)
+{
+    const int halfSide = sideLength/2;
+    const __m256i key = _mm256_set1_epi32((int)rowKey);
+    const __m256i lanes = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(sideLength));
+    const __m256 fMin = _mm256_set1_ps(-range);
+    const __m256 span = _mm256_set1_ps(range - -range);
+    const __m256 quarter = _mm256_set1_ps(0.25f);
+    __m256 vlo = _mm256_set1_ps(lo);
+    __m256 vhi = _mm256_set1_ps(hi);
+    int k = 0;
+    for(; k + 8 <= count; k += 8)
+    {
+        const int x = x0 + k*sideLength;
+        __m256 avg = _mm256_add_ps(_mm256_i32gather_ps(top + x - halfSide, lanes, 4), _mm256_i32gather_ps(top + x + halfSide, lanes, 4));
+        avg = _mm256_add_ps(avg, _mm256_i32gather_ps(bottom + x - halfSide, lanes, 4));
+        avg = _mm256_add_ps(avg, _mm256_i32gather_ps(bottom + x + halfSide, lanes, 4));
+        avg = _mm256_mul_ps(avg, quarter);
+        __m256 offset = RandomRangeAVX2(key, _mm256_add_epi32(_mm256_set1_epi32(x + keyOffset), lanes), fMin, span);
+        __m256 value = _mm256_add_ps(avg, offset);
+        StoreStridedAVX2(center + x, sideLength, value);
+        vlo = _mm256_min_ps(value, vlo);
+        vhi = _mm256_max_ps(value, vhi);
+    }
+    ReduceMinMaxAVX2(vlo, vhi, lo, hi);
+    // The scalar tail is legacy SSE code, clear the upper halves first
+    _mm256_zeroupper();
+    DiamondRowScalar(top, bottom, center, x0 + k*sideLength, count - k, sideLength, rowKey, keyOffset, range, lo, hi);
+}
+
+__attribute__((target("avx2")))
+static void SquareRowAVX2(const float* up, const float* down, float* row,
+    int x0, int count, int sideLength, uint32_t rowKey, int keyOffset, float range, float& lo, float& hi)
+{
+    const int halfSide = sideLength/2;
+    const __m256i key = _mm256_set1_epi32((int)rowKey);
+    const __m256i lanes = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(sideLength));
+    const __m256 fMin = _mm256_set1_ps(-range);
+    const __m256 span = _mm256_set1_ps(range - -range);
+    const __m256 four = _mm256_set1_ps(4.0f);
+    __m256 vlo = _mm256_set1_ps(lo);
+    __m256 vhi = _mm256_set1_ps(hi);
+    int k = 0;
+    for(; k + 8 <= count; k += 8)
+    {
+        const int x = x0 + k*sideLength;
+        __m256 sum = _mm256_add_ps(_mm256_i32gather_ps(up + x, lanes, 4), _mm256_i32gather_ps(down + x, lanes, 4));
+        sum = _mm256_add_ps(sum, _mm256_i32gather_ps(row + x + halfSide, lanes, 4));
+        sum = _mm256_add_ps(sum, _mm256_i32gather_ps(row + x - halfSide, lanes, 4));
+        __m256 offset = RandomRangeAVX2(key, _mm256_add_epi32(_mm256_set1_epi32(x + keyOffset), lanes), fMin, span);
+        __m256 value = _mm256_div_ps(sum, _mm256_add_ps(four, offset));
+        StoreStridedAVX2(row + x, sideLength, value);
+        vlo = _mm256_min_ps(value, vlo);
+        vhi = _mm256_max_ps(value, vhi);
+    }
+    ReduceMinMaxAVX2(vlo, vhi, lo, hi);
+    // The scalar tail is legacy SSE code, clear the upper halves first
+    _mm256_zeroupper();
+    SquareRowScalar(up, down, row, x0 + k*sideLength, count - k, sideLength, rowKey, keyOffset, range, lo, hi);
+}
+
+#endif//TERRAIN_X86
+
+//-----Dispatch-----//
+
+const DiamondSquareKernels& GetDiamondSquareKernels(SimdLevel level)
+{
+    static const DiamondSquareKernels scalar = { DiamondRowScalar, SquareRowScalar };
+#ifdef TERRAIN_X86
+    static const DiamondSquareKernels sse = { DiamondRowSSE, SquareRowSSE };
+    static const DiamondSquareKernels avx2 = { DiamondRowAVX2, SquareRowAVX2 };
+    static const SimdLevel best = GetBestSimdLevel();
+    if(level > best)
+    {
+        level = best;
+    }
+    if(level == SimdLevel::AVX2)
+    {
+        return avx2;
+    }
+    if(level == SimdLevel::SSE41)
+    {
+        return sse;
+    }
+#endif
+    return scalar;
+}
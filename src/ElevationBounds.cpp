@@ -0,0 +1,50 @@
+/*
+ * Copyright (c) 2018 Brendan Barnes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#include "ElevationBounds.h"
+#include "ThreadPool.h"
+
+void ComputeTileBounds(const HeightField& map, const int tileSize, std::vector<ElevationBounds>& bounds, const unsigned int threadCount)
+{
+    const int tilesPerSide = (map.GetWidth() - 1)/tileSize;
+    bounds.resize((size_t)tilesPerSide*tilesPerSide);
+    ThreadPool::SharedParallelFor(tilesPerSide, threadCount, [&](int first, int last)
+    {
+        for(int ty = first; ty < last; ty++)
+        {
+            for(int tx = 0; tx < tilesPerSide; tx++)
+            {
+                ElevationBounds tile = {map(tx*tileSize, ty*tileSize), map(tx*tileSize, ty*tileSize)};
+                for(int y = ty*tileSize; y <= (ty + 1)*tileSize; y++)
+                {
+                    const float* row = map.Row(y);
+                    for(int x = tx*tileSize; x <= (tx + 1)*tileSize; x++)
+                    {
+                        tile.minElevation = row[x] < tile.minElevation ? row[x] : tile.minElevation;
+                        tile.maxElevation = row[x] > tile.maxElevation ? row[x] : tile.maxElevation;
+                    }
+                }
+                bounds[(size_t)ty*tilesPerSide + tx] = tile;
+            }
+        }
+    });
+}
@@ -0,0 +1,323 @@
+/*
+ * Copyright (c) 2018 Brendan Barnes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "GeometryClipmap.h"
+#include "Random.h"
+#include "ThreadPool.h"
+#include <cmath>
+#include <cstdlib>
+
+// Octaves of the height noise, the coarsest has a lattice of 2^(CLIPMAP_OCTAVES - 1) cells
+static const int CLIPMAP_OCTAVES = 9;
+
+static inline float SmoothStep(float t)
+{
+    return t*t*(3.0f - 2.0f*t);
+}
+
+static inline int PositiveModulo(int x, int m)
+{
+    return ((x % m) + m) % m;
+}
+
+GeometryClipmap::GeometryClipmap(const int levelCount, const int gridSize, const float spacing, const float range, const unsigned int seed)
+    : mGridSize(gridSize), mTextureSize(gridSize + 2), mSpacing(spacing), mRange(range), mSeed(seed),
+      mThreadCount(0), mMinElevation(0.0f), mMaxElevation(0.0f), mLevels(levelCount), mStats()
+{
+    for(size_t l = 0; l < mLevels.size(); l++)
+    {
+        mLevels[l].originX = 0;
+        mLevels[l].originY = 0;
+        mLevels[l].resident = false;
+    }
+}
+
+float GeometryClipmap::SampleHeight(const unsigned int seed, const float range, const int x, const int y, const int level)
+{
+    // Lattices finer than two of the level's samples would alias
+    float height = 0.0f;
+    for(int octave = level + 1; octave < CLIPMAP_OCTAVES; octave++)
+    {
+        const int size = 1 << octave;
+        const int cellX = x >> octave;  // Floors negative cells too
+        const int cellY = y >> octave;
+        const float fx = SmoothStep((float)(x & (size - 1))/(float)size);
+        const float fy = SmoothStep((float)(y & (size - 1))/(float)size);
+        const uint32_t levelKey = HashLevelKey(seed, octave);
+        const uint32_t top = HashRowKey(levelKey, (uint32_t)cellY);
+        const uint32_t bottom = HashRowKey(levelKey, (uint32_t)(cellY + 1));
+        const float v00 = HashToRange(HashCell(top, (uint32_t)cellX), -1.0f, 1.0f);
+        const float v10 = HashToRange(HashCell(top, (uint32_t)(cellX + 1)), -1.0f, 1.0f);
+        const float v01 = HashToRange(HashCell(bottom, (uint32_t)cellX), -1.0f, 1.0f);
+        const float v11 = HashToRange(HashCell(bottom, (uint32_t)(cellX + 1)), -1.0f, 1.0f);
+        const float v0 = v00 + fx*(v10 - v00);
+        const float v1 = v01 + fx*(v11 - v01);
+        // Amplitude halves with the wavelength, as diamond-square's range does
+        const float amplitude = range*(float)size/(float)(1 << (CLIPMAP_OCTAVES - 1));
+        height += amplitude*(v0 + fy*(v1 - v0));
+    }
+    return height;
+}
+
+void GeometryClipmap::Update(const float cameraX, const float cameraY)
+{
+    mStats.uploadedTexels = 0;
+    const int half = (mGridSize - 1)/2;
+    const int quarter = (mGridSize - 1)/4;
+    const int size = mTextureSize;
+    for(size_t l = 0; l < mLevels.size(); l++)
+    {
+        Level& level = mLevels[l];
+        int originX;
+        int originY;
+        if(l == 0)
+        {
+            // Centred on the camera's finest cell
+            originX = (int)std::floor(cameraX/mSpacing) - half;
+            originY = (int)std::floor(-cameraY/mSpacing) - half;
+        }
+        else
+        {
+            // Around the finer level, leaving q or q + 1 cells on each side
+            originX = mLevels[l-1].originX/2 - quarter;
+            originY = mLevels[l-1].originY/2 - quarter;
+        }
+        // Even, so every other vertex lies on the coarser level's grid
+        originX &= ~1;
+        originY &= ~1;
+
+        // The texture holds level cells [origin - 1, origin - 1 + size)
+        const int newX = originX - 1;
+        const int newY = originY - 1;
+        const int oldX = level.originX - 1;
+        const int oldY = level.originY - 1;
+        level.originX = originX;
+        level.originY = originY;
+        if(!level.resident || std::abs(newX - oldX) >= size || std::abs(newY - oldY) >= size)
+        {
+            FillRegion((int)l, newX, newY, size, size);
+            level.resident = true;
+            mStats.refilledLevels++;
+            continue;
+        }
+
+        // Uncovered columns over the new window's height, then uncovered
+        // rows over the columns that were already there
+        int keptX0 = newX;
+        int keptX1 = newX + size;
+        if(newX > oldX)
+        {
+            FillRegion((int)l, oldX + size, newY, newX - oldX, size);
+            keptX1 = oldX + size;
+        }
+        else if(newX < oldX)
+        {
+            FillRegion((int)l, newX, newY, oldX - newX, size);
+            keptX0 = oldX;
+        }
+        if(newY > oldY)
+        {
+            FillRegion((int)l, keptX0, oldY + size, keptX1 - keptX0, newY - oldY);
+        }
+        else if(newY < oldY)
+        {
+            FillRegion((int)l, keptX0, newY, keptX1 - keptX0, oldY - newY);
+        }
+    }
+    mStats.totalUploadedTexels += mStats.uploadedTexels;
+}
+
+void GeometryClipmap::FillRegion(const int level, const int x0, const int y0, const int width, const int height)
+{
+    if(width <= 0 || height <= 0)
+    {
+        return;
+    }
+    Level& target = mLevels[level];
+    const int size = mTextureSize;
+    if(target.texture.GetID() == 0)
+    {
+        target.texture.CreateTexture(GL_RG32F, size, size, GL_RG, GL_FLOAT, nullptr);
+    }
+
+    // This level's height and, for the border to morph into, the height of
+    // the coarser level's triangles at the same point
+    mStaging.resize(2*(size_t)width*height);
+    float* texels = mStaging.data();
+    const int scale = 1 << level;
+    const bool coarsest = level + 1 == (int)mLevels.size();
+    const unsigned int seed = mSeed;
+    const float range = mRange;
+    ThreadPool::SharedParallelFor(height, mThreadCount, [&](int first, int last)
+    {
+        for(int r = first; r < last; r++)
+        {
+            const int y = y0 + r;
+            float* row = texels + 2*(size_t)r*width;
+            for(int c = 0; c < width; c++)
+            {
+                const int x = x0 + c;
+                const float fine = SampleHeight(seed, range, x*scale, y*scale, level);
+                float coarse = fine;
+                if(!coarsest)
+                {
+                    // Coarser vertices are the even cells. Odd ones sit on
+                    // an edge, or on the diagonal of a quad, which the grid
+                    // splits from bottom left to top right.
+                    const bool oddX = (x & 1) != 0;
+                    const bool oddY = (y & 1) != 0;
+                    const int ax = oddX ? x - 1 : x;
+                    const int ay = oddY ? y + 1 : y;
+                    const int bx = oddX ? x + 1 : x;
+                    const int by = oddY ? y - 1 : y;
+                    coarse = SampleHeight(seed, range, ax*scale, ay*scale, level + 1);
+                    if(oddX || oddY)
+                    {
+                        coarse = 0.5f*(coarse + SampleHeight(seed, range, bx*scale, by*scale, level + 1));
+                    }
+                }
+                row[2*c] = fine;
+                row[2*c + 1] = coarse;
+            }
+        }
+    });
+    for(size_t i = 0; i < mStaging.size(); i += 2)
+    {
+        mMinElevation = texels[i] < mMinElevation ? texels[i] : mMinElevation;
+        mMaxElevation = texels[i] > mMaxElevation ? texels[i] : mMaxElevation;
+    }
+
+    // The region wraps around the texture at most once on each axis
+    const int texelX = PositiveModulo(x0, size);
+    const int texelY = PositiveModulo(y0, size);
+    const int firstWidth = width < size - texelX ? width : size - texelX;
+    const int firstHeight = height < size - texelY ? height : size - texelY;
+    for(int part = 0; part < 4; part++)
+    {
+        const int c0 = (part & 1) ? firstWidth : 0;
+        const int c1 = (part & 1) ? width : firstWidth;
+        const int r0 = (part & 2) ? firstHeight : 0;
+        const int r1 = (part & 2) ? height : firstHeight;
+        if(c1 > c0 && r1 > r0)
+        {
+            target.texture.UpdateRegion((texelX + c0) % size, (texelY + r0) % size, c1 - c0, r1 - r0,
+                GL_RG, GL_FLOAT, texels + 2*((size_t)r0*width + c0), width);
+        }
+    }
+    mStats.uploadedTexels += (size_t)width*height;
+}
+
+void GeometryClipmap::GetHoleOffset(const int level, int& holeX, int& holeY) const
+{
+    holeX = mLevels[level-1].originX/2 - mLevels[level].originX;
+    holeY = mLevels[level-1].originY/2 - mLevels[level].originY;
+}
+
+void GeometryClipmap::BuildRingIndices()
+{
+    const int n = mGridSize;
+    const int quarter = (n - 1)/4;
+    const int holeSize = (n - 1)/2;
+    std::vector<unsigned int> indices;
+    indices.reserve(6*((size_t)(n - 1)*(n - 1) - (size_t)holeSize*holeSize));
+    for(int k = 0; k < 4; k++)
+    {
+        const int holeX = quarter + (k & 1);
+        const int holeY = quarter + (k >> 1);
+        indices.clear();
+        for(int i = 0; i < n - 1; i++)
+        {
+            for(int j = 0; j < n - 1; j++)
+            {
+                if(j >= holeX && j < holeX + holeSize && i >= holeY && i < holeY + holeSize)
+                {
+                    continue;
+                }
+                // Same quads as GridIndexCache's triangle lists
+                indices.push_back(n + j + i*n);
+                indices.push_back(0 + j + i*n);
+                indices.push_back(1 + j + i*n);
+                indices.push_back(1 + j + i*n);
+                indices.push_back(n+1 + j + i*n);
+                indices.push_back(n + j + i*n);
+            }
+        }
+        mRingIndices[k].CreateBuffer(indices.data(), indices.size());
+    }
+}
+
+void GeometryClipmap::Render(Shader* shader)
+{
+    if(mLevels.empty() || !mLevels[0].resident)
+    {
+        return;
+    }
+    if(!mFullIndices)
+    {
+        mFullIndices = GridIndexCache::Acquire(mGridSize, IndexLayout::TRIANGLE_LIST);
+        BuildRingIndices();
+    }
+    const int quarter = (mGridSize - 1)/4;
+    shader->Bind();
+    glUniform1i(7, mGridSize);
+    glUniform1i(17, mTextureSize);
+    mStats.triangles = 0;
+    mStats.gpuBytes = 0;
+    // Finest first, so nearer levels fill the depth buffer first
+    for(size_t l = 0; l < mLevels.size(); l++)
+    {
+        const Level& level = mLevels[l];
+        const float spacing = mSpacing*(float)(1 << l);
+        IndexBuffer* indices = &mFullIndices->buffer;
+        if(l > 0)
+        {
+            int holeX;
+            int holeY;
+            GetHoleOffset((int)l, holeX, holeY);
+            indices = &mRingIndices[(holeX - quarter) + 2*(holeY - quarter)];
+        }
+        level.texture.Bind(0);
+        glUniform2i(14, PositiveModulo(level.originX, mTextureSize), PositiveModulo(level.originY, mTextureSize));
+        glUniform2f(15, (float)level.originX*spacing, -(float)level.originY*spacing);
+        glUniform1f(16, spacing);
+        mMesh.SetIndices(indices);
+        mMesh.Render(shader, GL_TRIANGLES);
+        mStats.triangles += indices->GetCount()/3;
+        mStats.gpuBytes += level.texture.GetSize();
+    }
+}
+
+void GeometryClipmap::Release()
+{
+    for(size_t l = 0; l < mLevels.size(); l++)
+    {
+        mLevels[l].texture.Release();
+        mLevels[l].resident = false;
+    }
+    mFullIndices.reset();
+    for(int k = 0; k < 4; k++)
+    {
+        mRingIndices[k].Release();
+    }
+    mStats = ClipmapStats();
+}
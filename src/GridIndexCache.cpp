@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2018 Brendan Barnes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "GridIndexCache.h"
+
+std::mutex GridIndexCache::sMutex;
+std::map<GridIndexCache::Key, std::weak_ptr<GridIndices>> GridIndexCache::sEntries;
+
+std::shared_ptr<GridIndices> GridIndexCache::Acquire(const int gridSize, const IndexLayout layout)
+{
+    std::lock_guard<std::mutex> lock(sMutex);
+    std::shared_ptr<GridIndices> entry = FindOrBuild(gridSize, layout);
+    if(entry->buffer.GetID() == 0)
+    {
+        entry->buffer.CreateBuffer(entry->indices.data(), entry->indices.size());
+    }
+    return entry;
+}
+
+std::shared_ptr<GridIndices> GridIndexCache::Prepare(const int gridSize, const IndexLayout layout)
+{
+    std::lock_guard<std::mutex> lock(sMutex);
+    return FindOrBuild(gridSize, layout);
+}
+
+std::shared_ptr<GridIndices> GridIndexCache::FindOrBuild(const int gridSize, const IndexLayout layout)
+{
+    const Key key(gridSize, layout);
+    std::shared_ptr<GridIndices> entry = sEntries[key].lock();
+    if(entry)
+    {
+        return entry;
+    }
+
+    // Drop entries whose last holder is gone
+    for(std::map<Key, std::weak_ptr<GridIndices>>::iterator it = sEntries.begin(); it != sEntries.end();)
+    {
+        if(it->second.expired() && it->first != key)
+        {
+            it = sEntries.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    entry = std::make_shared<GridIndices>();
+    entry->gridSize = gridSize;
+    entry->layout = layout;
+    entry->primitive = GetPrimitiveType(layout);
+    entry->chunkSize = GetGridChunkSize(gridSize);
+    entry->chunksPerSide = gridSize > 1 ? (gridSize - 1)/entry->chunkSize : 0;
+    entry->chunkIndexCount = GetGridChunkIndexCount(entry->chunkSize, layout);
+    entry->indices.resize(GetGridIndexCount(gridSize, layout));
+    BuildGridIndices(gridSize, layout, entry->indices.data());
+    sEntries[key] = entry;
+    return entry;
+}
+
+GLenum GridIndexCache::GetPrimitiveType(const IndexLayout layout)
+{
+    return layout == IndexLayout::TRIANGLE_STRIP ? GL_TRIANGLE_STRIP : GL_TRIANGLES;
+}
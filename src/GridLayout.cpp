@@ -0,0 +1,99 @@
+/*
+ * Copyright (c) 2018 Brendan Barnes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "GridLayout.h"
+
+size_t GetGridIndexCount(const int n, const IndexLayout layout)
+{
+    if(n < 2)
+    {
+        return 0;
+    }
+    const size_t chunksPerSide = (n-1)/GetGridChunkSize(n);
+    return chunksPerSide*chunksPerSide*GetGridChunkIndexCount(GetGridChunkSize(n), layout);
+}
+
+int GetGridChunkSize(const int n)
+{
+    if(n-1 <= GRID_CHUNK_SIZE || (n-1)%GRID_CHUNK_SIZE != 0)
+    {
+        return n-1;
+    }
+    return GRID_CHUNK_SIZE;
+}
+
+size_t GetGridChunkIndexCount(const int chunkSize, const IndexLayout layout)
+{
+    if(layout == IndexLayout::TRIANGLE_STRIP)
+    {
+        return (size_t)chunkSize*(2*(chunkSize+1) + 1);
+    }
+    return 6*(size_t)chunkSize*chunkSize;
+}
+
+void BuildGridIndices(const int n, const IndexLayout layout, unsigned int* indices)
+{
+    if(n < 2)
+    {
+        return;
+    }
+    const int c = GetGridChunkSize(n);
+    const int chunksPerSide = (n-1)/c;
+    size_t k = 0;
+    for(int cy = 0; cy < chunksPerSide; cy++)
+    {
+        for(int cx = 0; cx < chunksPerSide; cx++)
+        {
+            const int x0 = cx*c;
+            for(int i = cy*c; i < (cy+1)*c; i++)
+            {
+                if(layout == IndexLayout::TRIANGLE_STRIP)
+                {
+                    // Each row of quads zig-zags between the row below and the
+                    // row above, which keeps the winding of the list layout.
+                    // Quads are split along the other diagonal, from the top
+                    // left to the bottom right vertex. Every row ends with a
+                    // restart so chunks have the same number of indices.
+                    for(int j = x0; j <= x0 + c; j++)
+                    {
+                        indices[k++] = n + j + i*n;
+                        indices[k++] = 0 + j + i*n;
+                    }
+                    indices[k++] = GRID_RESTART_INDEX;
+                    continue;
+                }
+
+                // Order to render vertices
+                for(int j = x0; j < x0 + c; j++)
+                {
+                    indices[k++] = n + j + i*n;
+                    indices[k++] = 0 + j + i*n;
+                    indices[k++] = 1 + j + i*n;
+                    indices[k++] = 1 + j + i*n;
+                    indices[k++] = n+1 + j + i*n;
+                    indices[k++] = n + j + i*n;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,492 @@
+/*
+ * Copyright (c) 2018 Brendan Barnes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "HeightFieldWriter.h"
+#include "HeightQuantizer.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sstream>
+#include <unistd.h>
+#include <vector>
+
+// Largest stored deflate block
+static const size_t DEFLATE_STORED_MAX = 65535;
+// Bytes Adler-32 can sum before its 32-bit accumulators must be reduced
+static const size_t ADLER_MAX_RUN = 5552;
+
+namespace
+{
+    // CRC-32 as used by PNG chunks, sliced by 8. entries[k][n] is the CRC
+    // of byte n followed by k zero bytes, so eight bytes take one lookup each.
+    struct CrcTable
+    {
+        uint32_t entries[8][256];
+
+        CrcTable()
+        {
+            for(uint32_t n = 0; n < 256; n++)
+            {
+                uint32_t c = n;
+                for(int k = 0; k < 8; k++)
+                {
+                    c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+                }
+                entries[0][n] = c;
+            }
+            for(int k = 1; k < 8; k++)
+            {
+                for(uint32_t n = 0; n < 256; n++)
+                {
+                    entries[k][n] = (entries[k-1][n] >> 8) ^ entries[0][entries[k-1][n] & 0xFF];
+                }
+            }
+        }
+    };
+
+    // Running CRC, start from 0xFFFFFFFF and invert at the end
+    uint32_t UpdateCrc(uint32_t crc, const unsigned char* data, size_t size)
+    {
+        static const CrcTable table;
+        const uint32_t (*t)[256] = table.entries;
+        for(; size >= 8; size -= 8, data += 8)
+        {
+            const uint32_t low = crc ^ (data[0] | (uint32_t)data[1] << 8 | (uint32_t)data[2] << 16 | (uint32_t)data[3] << 24);
+            crc = t[7][low & 0xFF] ^ t[6][(low >> 8) & 0xFF] ^ t[5][(low >> 16) & 0xFF] ^ t[4][low >> 24] ^
+                  t[3][data[4]] ^ t[2][data[5]] ^ t[1][data[6]] ^ t[0][data[7]];
+        }
+        for(; size > 0; size--)
+        {
+            crc = t[0][(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+        }
+        return crc;
+    }
+
+    // Running Adler-32 of the zlib stream, start from 1
+    uint32_t UpdateAdler(uint32_t adler, const unsigned char* data, size_t size)
+    {
+        uint32_t a = adler & 0xFFFF;
+        uint32_t b = adler >> 16;
+        while(size > 0)
+        {
+            size_t run = size < ADLER_MAX_RUN ? size : ADLER_MAX_RUN;
+            size -= run;
+            while(run-- > 0)
+            {
+                a += *data++;
+                b += a;
+            }
+            a %= 65521;
+            b %= 65521;
+        }
+        return (b << 16) | a;
+    }
+
+    inline void StoreBigEndian32(unsigned char* out, uint32_t value)
+    {
+        out[0] = (unsigned char)(value >> 24);
+        out[1] = (unsigned char)(value >> 16);
+        out[2] = (unsigned char)(value >> 8);
+        out[3] = (unsigned char)value;
+    }
+}
+
+HeightFieldWriter::HeightFieldWriter()
+    : mBuffers(nullptr), mBuffer(nullptr), mBufferSize(8 << 20), mUsed(0), mFile(-1), mDirectIO(false), mDirect(false), mFailed(false)
+{
+
+}
+
+HeightFieldWriter::~HeightFieldWriter()
+{
+    free(mBuffers);
+}
+
+void HeightFieldWriter::SetBufferSize(const size_t bytes)
+{
+    const size_t size = bytes > BLOCK_SIZE ? (bytes + BLOCK_SIZE - 1)/BLOCK_SIZE*BLOCK_SIZE : BLOCK_SIZE;
+    if(size != mBufferSize)
+    {
+        free(mBuffers);
+        mBuffers = nullptr;
+        mBufferSize = size;
+    }
+}
+
+const char* HeightFieldWriter::GetExtension(const HeightFileFormat format)
+{
+    switch(format)
+    {
+        case HeightFileFormat::PNG16:
+            return "png";
+        case HeightFileFormat::ENVI_BIL:
+            return "bil";
+        default:
+            return "raw";
+    }
+}
+
+bool HeightFieldWriter::ParseFormat(const char* name, HeightFileFormat& format)
+{
+    const HeightFileFormat formats[] = { HeightFileFormat::RAW_FLOAT32, HeightFileFormat::PNG16, HeightFileFormat::ENVI_BIL };
+    for(int i = 0; i < 3; i++)
+    {
+        if(strcmp(name, GetExtension(formats[i])) == 0)
+        {
+            format = formats[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+bool HeightFieldWriter::Write(const std::string& path, HeightFieldView<const float> map, const HeightFileFormat format,
+    const float minElevation, const float maxElevation)
+{
+    if(!Open(path))
+    {
+        return false;
+    }
+    if(format == HeightFileFormat::PNG16)
+    {
+        WritePng(map, minElevation, maxElevation);
+    }
+    else
+    {
+        WriteRows(map);
+    }
+    if(!Close())
+    {
+        return false;
+    }
+
+    std::ostringstream header;
+    header.precision(9);
+    if(format == HeightFileFormat::RAW_FLOAT32)
+    {
+        header << "{\n"
+               << "    \"width\": " << map.GetWidth() << ",\n"
+               << "    \"height\": " << map.GetHeight() << ",\n"
+               << "    \"type\": \"float32\",\n"
+               << "    \"byteOrder\": \"little\",\n"
+               << "    \"spacing\": " << 2.0f/(float)(map.GetWidth() - 1) << ",\n"
+               << "    \"minElevation\": " << minElevation << ",\n"
+               << "    \"maxElevation\": " << maxElevation << "\n"
+               << "}\n";
+        return WriteSidecar(path + ".json", header.str());
+    }
+    if(format == HeightFileFormat::ENVI_BIL)
+    {
+        // data type 4 is float32, byte order 0 little-endian
+        header << "ENVI\n"
+               << "description = {Terrain DEM}\n"
+               << "samples = " << map.GetWidth() << "\n"
+               << "lines = " << map.GetHeight() << "\n"
+               << "bands = 1\n"
+               << "header offset = 0\n"
+               << "file type = ENVI Standard\n"
+               << "data type = 4\n"
+               << "interleave = bil\n"
+               << "byte order = 0\n"
+               << "z plot range = {" << minElevation << ", " << maxElevation << "}\n";
+        // dem.bil is described by dem.hdr
+        const size_t dot = path.rfind('.');
+        const size_t slash = path.rfind('/');
+        const bool hasExtension = dot != std::string::npos && (slash == std::string::npos || dot > slash);
+        return WriteSidecar((hasExtension ? path.substr(0, dot) : path) + ".hdr", header.str());
+    }
+    return true;
+}
+
+bool HeightFieldWriter::Open(const std::string& path)
+{
+    if(mBuffers == nullptr)
+    {
+        void* memory = nullptr;
+        if(posix_memalign(&memory, BLOCK_SIZE, 2*mBufferSize) != 0)
+        {
+            std::cout << "Failed to allocate " << 2*mBufferSize << " bytes of write buffers" << std::endl;
+            return false;
+        }
+        mBuffers = static_cast<unsigned char*>(memory);
+    }
+
+    const int flags = O_WRONLY | O_CREAT | O_TRUNC;
+    mFile = -1;
+    mDirect = false;
+#ifdef O_DIRECT
+    if(mDirectIO)
+    {
+        mFile = open(path.c_str(), flags | O_DIRECT, 0644);
+        mDirect = mFile >= 0;
+    }
+#endif
+    if(mFile < 0)
+    {
+        mFile = open(path.c_str(), flags, 0644);
+    }
+    if(mFile < 0)
+    {
+        std::cout << "Failed to open " << path << ": " << strerror(errno) << std::endl;
+        return false;
+    }
+    mPath = path;
+    mBuffer = mBuffers;
+    mUsed = 0;
+    mFailed = false;
+    return true;
+}
+
+void HeightFieldWriter::Append(const void* data, size_t size)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    while(size > 0)
+    {
+        const size_t space = mBufferSize - mUsed;
+        const size_t run = size < space ? size : space;
+        memcpy(mBuffer + mUsed, bytes, run);
+        mUsed += run;
+        bytes += run;
+        size -= run;
+        if(mUsed == mBufferSize)
+        {
+            Flush();
+        }
+    }
+}
+
+void HeightFieldWriter::Flush()
+{
+    WaitForWrite();
+    if(!mFailed)
+    {
+        const unsigned char* data = mBuffer;
+        const size_t size = mUsed;
+        mPending = std::async(std::launch::async, [this, data, size]() { return WriteBlock(data, size); });
+    }
+    mBuffer = mBuffer == mBuffers ? mBuffers + mBufferSize : mBuffers;
+    mUsed = 0;
+}
+
+void HeightFieldWriter::WaitForWrite()
+{
+    if(mPending.valid() && !mPending.get())
+    {
+        mFailed = true;
+    }
+}
+
+bool HeightFieldWriter::WriteBlock(const unsigned char* data, const size_t size)
+{
+    size_t written = 0;
+    while(written < size)
+    {
+        const ssize_t result = write(mFile, data + written, size - written);
+        if(result < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if(result <= 0)
+        {
+            std::cout << "Failed to write " << mPath << ": " << strerror(errno) << std::endl;
+            return false;
+        }
+        written += result;
+    }
+    return true;
+}
+
+bool HeightFieldWriter::Close()
+{
+    WaitForWrite();
+#ifdef O_DIRECT
+    if(mDirect && mUsed%BLOCK_SIZE != 0)
+    {
+        // Direct writes must be whole blocks, the tail goes through the cache
+        fcntl(mFile, F_SETFL, fcntl(mFile, F_GETFL) & ~O_DIRECT);
+    }
+#endif
+    if(!mFailed && mUsed > 0 && !WriteBlock(mBuffer, mUsed))
+    {
+        mFailed = true;
+    }
+    mUsed = 0;
+    if(close(mFile) != 0 && !mFailed)
+    {
+        std::cout << "Failed to write " << mPath << ": " << strerror(errno) << std::endl;
+        mFailed = true;
+    }
+    mFile = -1;
+    return !mFailed;
+}
+
+void HeightFieldWriter::WriteRows(HeightFieldView<const float> map)
+{
+    const int width = map.GetWidth();
+    for(int y = 0; y < map.GetHeight(); y++)
+    {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        const float* row = map.Row(y);
+        for(int x = 0; x < width; x++)
+        {
+            uint32_t bits;
+            memcpy(&bits, row + x, sizeof(bits));
+            bits = __builtin_bswap32(bits);
+            Append(&bits, sizeof(bits));
+        }
+#else
+        Append(map.Row(y), width*sizeof(float));
+#endif
+    }
+}
+
+void HeightFieldWriter::WritePng(HeightFieldView<const float> map, const float minElevation, const float maxElevation)
+{
+    static const unsigned char signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+    const int width = map.GetWidth();
+    const int height = map.GetHeight();
+    const float range = maxElevation - minElevation;
+    const float scale = range > 0.0f ? QUANTIZED_HEIGHT_MAX/range : 0.0f;
+    Append(signature, sizeof(signature));
+
+    // 16-bit greyscale, no interlacing
+    unsigned char header[13];
+    StoreBigEndian32(header, width);
+    StoreBigEndian32(header + 4, height);
+    header[8] = 16;
+    header[9] = 0;
+    header[10] = 0;
+    header[11] = 0;
+    header[12] = 0;
+    uint32_t crc;
+    BeginPngChunk("IHDR", sizeof(header), crc);
+    AppendPngData(header, sizeof(header), crc);
+    EndPngChunk(crc);
+
+    // The zlib stream is left uncompressed, as stored deflate blocks, so
+    // every chunk's length is known before its rows are converted. Each band
+    // of rows is one IDAT chunk with its own blocks.
+    const size_t rowBytes = 1 + 2*(size_t)width;   // Filter type 0, then big-endian heights
+    const int bandRows = mBufferSize/rowBytes > 1 ? (int)(mBufferSize/rowBytes) : 1;
+    std::vector<unsigned char> scanline(rowBytes);
+    uint32_t adler = 1;
+    for(int first = 0; first < height; first += bandRows)
+    {
+        const int last = first + bandRows < height ? first + bandRows : height;
+        const size_t bandBytes = (size_t)(last - first)*rowBytes;
+        const size_t blockCount = (bandBytes + DEFLATE_STORED_MAX - 1)/DEFLATE_STORED_MAX;
+        const bool firstBand = first == 0;
+        const bool lastBand = last == height;
+        BeginPngChunk("IDAT", (uint32_t)(bandBytes + 5*blockCount + (firstBand ? 2 : 0) + (lastBand ? 4 : 0)), crc);
+        if(firstBand)
+        {
+            // Deflate with a 32K window, no preset dictionary
+            const unsigned char zlibHeader[2] = { 0x78, 0x01 };
+            AppendPngData(zlibHeader, sizeof(zlibHeader), crc);
+        }
+
+        size_t bandLeft = bandBytes;
+        size_t blockLeft = 0;
+        for(int y = first; y < last; y++)
+        {
+            const float* row = map.Row(y);
+            scanline[0] = 0;
+            for(int x = 0; x < width; x++)
+            {
+                const uint16_t q = QuantizeHeight(row[x], minElevation, scale);
+                scanline[1 + 2*x] = (unsigned char)(q >> 8);
+                scanline[2 + 2*x] = (unsigned char)q;
+            }
+            adler = UpdateAdler(adler, scanline.data(), rowBytes);
+
+            size_t offset = 0;
+            while(offset < rowBytes)
+            {
+                if(blockLeft == 0)
+                {
+                    blockLeft = bandLeft < DEFLATE_STORED_MAX ? bandLeft : DEFLATE_STORED_MAX;
+                    const bool finalBlock = lastBand && blockLeft == bandLeft;
+                    const unsigned char blockHeader[5] = {
+                        (unsigned char)(finalBlock ? 1 : 0),
+                        (unsigned char)blockLeft, (unsigned char)(blockLeft >> 8),
+                        (unsigned char)~blockLeft, (unsigned char)(~blockLeft >> 8)
+                    };
+                    AppendPngData(blockHeader, sizeof(blockHeader), crc);
+                }
+                const size_t run = rowBytes - offset < blockLeft ? rowBytes - offset : blockLeft;
+                AppendPngData(scanline.data() + offset, run, crc);
+                offset += run;
+                blockLeft -= run;
+                bandLeft -= run;
+            }
+        }
+
+        if(lastBand)
+        {
+            unsigned char trailer[4];
+            StoreBigEndian32(trailer, adler);
+            AppendPngData(trailer, sizeof(trailer), crc);
+        }
+        EndPngChunk(crc);
+    }
+
+    BeginPngChunk("IEND", 0, crc);
+    EndPngChunk(crc);
+}
+
+void HeightFieldWriter::BeginPngChunk(const char* type, const uint32_t length, uint32_t& crc)
+{
+    unsigned char header[8];
+    StoreBigEndian32(header, length);
+    memcpy(header + 4, type, 4);
+    Append(header, sizeof(header));
+    // The CRC covers the type and data, not the length
+    crc = UpdateCrc(0xFFFFFFFFu, header + 4, 4);
+}
+
+void HeightFieldWriter::AppendPngData(const void* data, const size_t size, uint32_t& crc)
+{
+    crc = UpdateCrc(crc, static_cast<const unsigned char*>(data), size);
+    Append(data, size);
+}
+
+void HeightFieldWriter::EndPngChunk(const uint32_t crc)
+{
+    unsigned char trailer[4];
+    StoreBigEndian32(trailer, crc ^ 0xFFFFFFFFu);
+    Append(trailer, sizeof(trailer));
+}
+
+bool HeightFieldWriter::WriteSidecar(const std::string& path, const std::string& text)
+{
+    FILE* file = fopen(path.c_str(), "w");
+    bool ok = file != nullptr && fwrite(text.data(), 1, text.size(), file) == text.size();
+    ok = file != nullptr && fclose(file) == 0 && ok;
+    if(!ok)
+    {
+        std::cout << "Failed to write " << path << std::endl;
+    }
+    return ok;
+}
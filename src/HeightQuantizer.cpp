@@ -0,0 +1,57 @@
+/*
+ * Copyright (c) 2018 Brendan Barnes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "HeightQuantizer.h"
+#include "ThreadPool.h"
+#include <math.h>
+#include <mutex>
+
+float QuantizeHeights(HeightFieldView<const float> map, float minElevation, float maxElevation,
+    QuantizedHeightField& quantized, unsigned int threadCount)
+{
+    const int width = map.GetWidth();
+    const float range = maxElevation - minElevation;
+    const float scale = range > 0.0f ? QUANTIZED_HEIGHT_MAX/range : 0.0f;
+    quantized.Allocate(width, map.GetHeight());
+
+    std::mutex errorMutex;
+    float maxError = 0.0f;
+    ThreadPool::SharedParallelFor(map.GetHeight(), threadCount, [&](int first, int last)
+    {
+        float bandError = 0.0f;
+        for(int y = first; y < last; y++)
+        {
+            const float* row = map.Row(y);
+            uint16_t* out = quantized.Row(y);
+            for(int x = 0; x < width; x++)
+            {
+                out[x] = QuantizeHeight(row[x], minElevation, scale);
+                float error = fabsf(DequantizeHeight(out[x], minElevation, maxElevation) - row[x]);
+                bandError = error > bandError ? error : bandError;
+            }
+        }
+        std::lock_guard<std::mutex> lock(errorMutex);
+        maxError = bandError > maxError ? bandError : maxError;
+    });
+    return maxError;
+}
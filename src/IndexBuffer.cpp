@@ -24,21 +24,46 @@
 #include "IndexBuffer.h"
 
 IndexBuffer::IndexBuffer()
+    : mID(0), mCount(0), mSize(0)
 {
 
 }
 
 IndexBuffer::~IndexBuffer()
 {
-    GLCall( glDeleteBuffers(1, &mID) );
+    Release();
 }
 
 void IndexBuffer::CreateBuffer(const unsigned int* indices, unsigned int count)
 {
+    const size_t size = (size_t)4*count;
     mCount = count;
-    GLCall(glGenBuffers(1, &mID));
+    if(mID == 0)
+    {
+        GLCall(glGenBuffers(1, &mID));
+    }
     GLCall( glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mID) );
-    GLCall(glBufferData(GL_ELEMENT_ARRAY_BUFFER, 4*count, indices, GL_STATIC_DRAW));
+    if(size == mSize)
+    {
+        GLCall(glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, size, indices));
+        return;
+    }
+    GLCall(glBufferData(GL_ELEMENT_ARRAY_BUFFER, size, indices, GL_STATIC_DRAW));
+    GpuMemory::Freed(mSize);
+    GpuMemory::Allocated(size);
+    mSize = size;
+}
+
+void IndexBuffer::Release()
+{
+    if(mID != 0)
+    {
+        GLCall( glDeleteBuffers(1, &mID) );
+        GpuMemory::Freed(mSize);
+    }
+    mID = 0;
+    mCount = 0;
+    mSize = 0;
 }
 
 void IndexBuffer::Bind() const
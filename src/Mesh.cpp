@@ -35,16 +35,50 @@ Mesh::~Mesh()
 }
 
 void Mesh::SetVerticies(VertexBuffer *vertexBuffer, unsigned int position)
+{
+    VertexLayout layout;
+    layout.Add(position, 3, GL_FLOAT);
+    SetVerticies(vertexBuffer, layout);
+}
+
+void Mesh::SetVerticies(VertexBuffer *vertexBuffer, const VertexLayout& layout)
 {
     mVboPtr = vertexBuffer;
+    BindAttributes(vertexBuffer, layout, 0);
+}
+
+void Mesh::SetInstances(VertexBuffer *instanceBuffer, const VertexLayout& layout)
+{
+    BindAttributes(instanceBuffer, layout, 1);
+}
+
+void Mesh::BindAttributes(VertexBuffer *buffer, const VertexLayout& layout, unsigned int divisor)
+{
     if(mVao == 0)
     {
         GLCall( glGenVertexArrays(1, &mVao) );
     }
     GLCall( glBindVertexArray(mVao) );
-    mVboPtr[0].Bind();
-    GLCall( glEnableVertexAttribArray(position) );
-    GLCall( glVertexAttribPointer(position, 3, GL_FLOAT, GL_FALSE, 0, 0) );
+    buffer[0].Bind();
+    const std::vector<VertexAttribute>& attributes = layout.GetAttributes();
+    for(size_t i = 0; i < attributes.size(); i++)
+    {
+        const VertexAttribute& attribute = attributes[i];
+        GLCall( glEnableVertexAttribArray(attribute.location) );
+        GLCall( glVertexAttribPointer(attribute.location, attribute.size, attribute.type, attribute.normalized,
+            layout.GetStride(), (const void*)(size_t)attribute.offset) );
+        GLCall( glVertexAttribDivisor(attribute.location, divisor) );
+    }
+}
+
+void Mesh::DisableVerticies(unsigned int position)
+{
+    if(mVao == 0)
+    {
+        GLCall( glGenVertexArrays(1, &mVao) );
+    }
+    GLCall( glBindVertexArray(mVao) );
+    GLCall( glDisableVertexAttribArray(position) );
 }
 
 void Mesh::SetIndices(IndexBuffer *indexBuffer)
@@ -58,7 +92,7 @@ void Mesh::SetIndices(IndexBuffer *indexBuffer)
     mIboPtr[0].Bind();
 }
 
-void Mesh::Render(Shader* shader)
+void Mesh::Render(Shader* shader, GLenum primitive)
 {
     if(mVboPtr == nullptr && mIboPtr == nullptr)
     {
@@ -69,14 +103,38 @@ void Mesh::Render(Shader* shader)
     {
         shader[0].Bind();
         GLCall( glBindVertexArray(mVao) );
-        glDrawArrays(GL_TRIANGLES, 0, mVboPtr[0].GetCount());
+        glDrawArrays(primitive, 0, mVboPtr[0].GetCount());
         return;
     }
-    else if(mIboPtr != nullptr && mVboPtr != nullptr)
+    else if(mIboPtr != nullptr)
     {
         shader[0].Bind();
         GLCall( glBindVertexArray(mVao) );
-        glDrawElements(GL_TRIANGLES, mIboPtr[0].GetCount(), GL_UNSIGNED_INT, nullptr);
+        glDrawElements(primitive, mIboPtr[0].GetCount(), GL_UNSIGNED_INT, nullptr);
         return;
     }
 }
+
+void Mesh::RenderRanges(Shader* shader, GLenum primitive, const GLsizei* counts, const void* const* offsets, GLsizei rangeCount)
+{
+    if(mIboPtr == nullptr)
+    {
+        std::cout << "Nothing to draw..." << std::endl;
+        return;
+    }
+    shader[0].Bind();
+    GLCall( glBindVertexArray(mVao) );
+    GLCall( glMultiDrawElements(primitive, counts, GL_UNSIGNED_INT, offsets, rangeCount) );
+}
+
+void Mesh::RenderInstanced(Shader* shader, GLenum primitive, unsigned int instanceCount, unsigned int baseInstance)
+{
+    if(mIboPtr == nullptr)
+    {
+        std::cout << "Nothing to draw..." << std::endl;
+        return;
+    }
+    shader[0].Bind();
+    GLCall( glBindVertexArray(mVao) );
+    GLCall( glDrawElementsInstancedBaseInstance(primitive, mIboPtr[0].GetCount(), GL_UNSIGNED_INT, nullptr, instanceCount, baseInstance) );
+}
@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2018 Brendan Barnes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "RingBuffer.h"
+#include <chrono>
+
+RingBuffer::RingBuffer()
+    : mID(0), mSize(0), mMapped(nullptr), mHead(0), mReservedOffset(0), mReservedSize(0)
+{
+    mStats.reservations = 0;
+    mStats.wraps = 0;
+    mStats.stalls = 0;
+    mStats.stallMilliseconds = 0.0;
+}
+
+RingBuffer::~RingBuffer()
+{
+    Release();
+}
+
+bool RingBuffer::IsSupported()
+{
+    return glBufferStorage != nullptr && (GLEW_VERSION_4_4 || GLEW_ARB_buffer_storage);
+}
+
+void RingBuffer::Create(size_t size)
+{
+    Release();
+    const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+    GLCall( glGenBuffers(1, &mID) );
+    GLCall( glBindBuffer(GL_COPY_WRITE_BUFFER, mID) );
+    GLCall( glBufferStorage(GL_COPY_WRITE_BUFFER, size, nullptr, flags) );
+    GLCall( mMapped = (char*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, size, flags) );
+    if(mMapped == nullptr)
+    {
+        std::cout << "Failed to map ring buffer!" << std::endl;
+        GLCall( glDeleteBuffers(1, &mID) );
+        mID = 0;
+        return;
+    }
+    mSize = size;
+    GpuMemory::Allocated(mSize);
+}
+
+void RingBuffer::Release()
+{
+    for(size_t i = 0; i < mFences.size(); i++)
+    {
+        GLCall( glDeleteSync(mFences[i].sync) );
+    }
+    mFences.clear();
+    if(mID != 0)
+    {
+        // Deleting a buffer unmaps it
+        GLCall( glDeleteBuffers(1, &mID) );
+        GpuMemory::Freed(mSize);
+    }
+    mID = 0;
+    mSize = 0;
+    mMapped = nullptr;
+    mHead = 0;
+    mReservedOffset = 0;
+    mReservedSize = 0;
+}
+
+void* RingBuffer::Reserve(size_t size, size_t alignment)
+{
+    if(mMapped == nullptr || size > mSize)
+    {
+        return nullptr;
+    }
+    mStats.reservations++;
+    size_t begin = (mHead + alignment - 1)/alignment*alignment;
+    if(begin + size > mSize)
+    {
+        begin = 0;
+        mStats.wraps++;
+    }
+    const size_t end = begin + size;
+
+    // Spans are committed in ring order, so the ones this overlaps are the
+    // oldest. Retire fences from the front until none overlap.
+    for(;;)
+    {
+        bool overlaps = false;
+        for(size_t i = 0; i < mFences.size() && !overlaps; i++)
+        {
+            overlaps = mFences[i].begin < end && begin < mFences[i].end;
+        }
+        if(!overlaps)
+        {
+            break;
+        }
+        WaitFor(mFences.front());
+        mFences.pop_front();
+    }
+
+    mReservedOffset = begin;
+    mReservedSize = size;
+    mHead = end;
+    return mMapped + begin;
+}
+
+void RingBuffer::Commit()
+{
+    if(mReservedSize == 0)
+    {
+        return;
+    }
+    Fence fence;
+    fence.begin = mReservedOffset;
+    fence.end = mReservedOffset + mReservedSize;
+    GLCall( fence.sync = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0) );
+    mFences.push_back(fence);
+    mReservedSize = 0;
+}
+
+void RingBuffer::WaitFor(Fence& fence)
+{
+    GLenum result;
+    GLCall( result = glClientWaitSync(fence.sync, 0, 0) );
+    if(result == GL_TIMEOUT_EXPIRED)
+    {
+        mStats.stalls++;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        do
+        {
+            GLCall( result = glClientWaitSync(fence.sync, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000) );
+        } while(result == GL_TIMEOUT_EXPIRED);
+        std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        mStats.stallMilliseconds += elapsed.count();
+    }
+    GLCall( glDeleteSync(fence.sync) );
+}
@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) 2018 Brendan Barnes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "RtinHierarchy.h"
+#include "ThreadPool.h"
+#include <cmath>
+
+RtinHierarchy::RtinHierarchy()
+    : mGridSize(0), mIndices(nullptr), mMaxError(0.0f), mVertexCount(0)
+{
+
+}
+
+void RtinHierarchy::Clear()
+{
+    mGridSize = 0;
+    mErrors = std::vector<float>();
+    mVertexMarks = std::vector<unsigned char>();
+}
+
+void RtinHierarchy::Build(const HeightField& map, const unsigned int threadCount)
+{
+    const int n = map.GetWidth();
+    const int last = n - 1;
+    mGridSize = n;
+    mErrors.assign((size_t)n*n, 0.0f);
+    float* errors = mErrors.data();
+
+    // Levels from the finest up. At scale s the edge midpoints split
+    // hypotenuses of length 2s along an axis, then the square centres split
+    // the diagonals of 2s squares.
+    for(int s = 1; s < last; s *= 2)
+    {
+        const int half = s/2;
+        ThreadPool::SharedParallelFor(last/s + 1, threadCount, [&](int first, int end)
+        {
+            for(int r = first; r < end; r++)
+            {
+                const int y = r*s;
+                const bool horizontal = y % (2*s) == 0;
+                const float* row = map.Row(y);
+                float* errorRow = errors + (size_t)y*n;
+                for(int x = horizontal ? s : 0; x <= last; x += 2*s)
+                {
+                    float error;
+                    float childError = 0.0f;
+                    if(horizontal)
+                    {
+                        error = std::fabs(row[x] - 0.5f*(row[x - s] + row[x + s]));
+                        // Right angles above and below, children are the
+                        // centres of the squares on either side
+                        for(int d = -1; half > 0 && d <= 1; d += 2)
+                        {
+                            if(y + d*s >= 0 && y + d*s <= last)
+                            {
+                                const float* childRow = errors + (size_t)(y + d*half)*n;
+                                childError = std::fmax(childError, std::fmax(childRow[x - half], childRow[x + half]));
+                            }
+                        }
+                    }
+                    else
+                    {
+                        error = std::fabs(row[x] - 0.5f*(map(x, y - s) + map(x, y + s)));
+                        for(int d = -1; half > 0 && d <= 1; d += 2)
+                        {
+                            if(x + d*s >= 0 && x + d*s <= last)
+                            {
+                                childError = std::fmax(childError, std::fmax(errors[(size_t)(y - half)*n + x + d*half],
+                                    errors[(size_t)(y + half)*n + x + d*half]));
+                            }
+                        }
+                    }
+                    errorRow[x] = std::fmax(error, childError);
+                }
+            }
+        });
+
+        // The diagonal of each square runs through the corner it shares
+        // with the other three squares of its parent
+        ThreadPool::SharedParallelFor(last/(2*s), threadCount, [&](int first, int end)
+        {
+            for(int r = first; r < end; r++)
+            {
+                const int y = s + r*2*s;
+                const int cy = (y - s) % (4*s) == 2*s ? y - s : y + s;
+                float* errorRow = errors + (size_t)y*n;
+                for(int x = s; x < last; x += 2*s)
+                {
+                    const int cx = (x - s) % (4*s) == 2*s ? x - s : x + s;
+                    const float error = std::fabs(map(x, y) - 0.5f*(map(cx, cy) + map(2*x - cx, 2*y - cy)));
+                    const float childError = std::fmax(std::fmax(errorRow[x - s], errorRow[x + s]),
+                        std::fmax(errors[(size_t)(y - s)*n + x], errors[(size_t)(y + s)*n + x]));
+                    errorRow[x] = std::fmax(error, childError);
+                }
+            }
+        });
+    }
+}
+
+void RtinHierarchy::Extract(const float maxError, std::vector<unsigned int>& indices, RtinStats* stats)
+{
+    const int last = mGridSize - 1;
+    indices.clear();
+    if(mGridSize < 2)
+    {
+        return;
+    }
+    mVertexMarks.assign((size_t)mGridSize*mGridSize, 0);
+    mIndices = &indices;
+    mMaxError = maxError;
+    mVertexCount = 0;
+    ExtractTriangle(0, 0, last, last, last, 0);
+    ExtractTriangle(last, last, 0, 0, 0, last);
+    mIndices = nullptr;
+    if(stats != nullptr)
+    {
+        stats->vertices = mVertexCount;
+        stats->triangles = indices.size()/3;
+        stats->maxError = maxError;
+    }
+}
+
+void RtinHierarchy::ExtractTriangle(const int ax, const int ay, const int bx, const int by, const int cx, const int cy)
+{
+    const int mx = (ax + bx)/2;
+    const int my = (ay + by)/2;
+    // Legs of one cell have no grid vertex on their hypotenuse
+    if(std::abs(ax - cx) + std::abs(ay - cy) > 1 && mErrors[(size_t)my*mGridSize + mx] > mMaxError)
+    {
+        // Halves keep the winding of the parent
+        ExtractTriangle(cx, cy, ax, ay, mx, my);
+        ExtractTriangle(bx, by, cx, cy, mx, my);
+        return;
+    }
+    // Model space flips the grid's y, which makes a, b, c counter-clockwise
+    AddVertex(ax, ay);
+    AddVertex(cx, cy);
+    AddVertex(bx, by);
+}
+
+void RtinHierarchy::AddVertex(const int x, const int y)
+{
+    const size_t index = (size_t)y*mGridSize + x;
+    mVertexCount += mVertexMarks[index] == 0 ? 1 : 0;
+    mVertexMarks[index] = 1;
+    mIndices->push_back((unsigned int)index);
+}
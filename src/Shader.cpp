@@ -46,17 +46,42 @@ Shader::ShaderSource Shader::ParseShader(std::string& filepath)
 
 	enum class ShaderType
 	{
-		NONE = -1, VERTEX = 0, FRAGMENT = 1
+		NONE = -1, VERTEX = 0, FRAGMENT = 1, TESS_CONTROL = 2, TESS_EVALUATION = 3
 	};
 
+	// Includes are found next to the including file
+	const size_t slash = filepath.find_last_of('/');
+	const std::string directory = slash == std::string::npos ? "" : filepath.substr(0, slash + 1);
+
 	std::string line;
-	std::stringstream ss[2];
+	std::stringstream ss[4];
 	ShaderType type = ShaderType::NONE;
 	while (getline(stream, line))
 	{
-		if (line.find("#shader") != std::string::npos)
+		if (line.find("#include") == 0 && type != ShaderType::NONE)
+		{
+			const size_t open = line.find('"');
+			const size_t close = line.find('"', open + 1);
+			const std::string path = directory + line.substr(open + 1, close - open - 1);
+			std::ifstream include(path);
+			if (open == std::string::npos || close == std::string::npos || !include.is_open())
+			{
+				std::cout << "Failed to open shader include " << path << "!" << std::endl;
+				continue;
+			}
+			ss[(int)type] << include.rdbuf() << '\n';
+		}
+		else if (line.find("#shader") != std::string::npos)
 		{
-			if (line.find("vertex") != std::string::npos)
+			if (line.find("tess_control") != std::string::npos)
+			{
+				type = ShaderType::TESS_CONTROL;
+			}
+			else if (line.find("tess_evaluation") != std::string::npos)
+			{
+				type = ShaderType::TESS_EVALUATION;
+			}
+			else if (line.find("vertex") != std::string::npos)
 			{
 				type = ShaderType::VERTEX;
 			}
@@ -65,60 +90,86 @@ Shader::ShaderSource Shader::ParseShader(std::string& filepath)
 				type = ShaderType::FRAGMENT;
 			}
 		}
-		else
+		else if (type != ShaderType::NONE)
 		{
 			ss[(int)type] << line << '\n';
 		}
 	}
-	return { ss[0].str(), ss[1].str() };
+	return { ss[0].str(), ss[1].str(), ss[2].str(), ss[3].str() };
 }
 
-void Shader::CompileShader(Shader::ShaderSource shaderSource)
+GLuint Shader::CompileStage(GLenum type, const std::string& source, const char* name)
 {
-    GLCall(unsigned int vs = glCreateShader(GL_VERTEX_SHADER));
-	const char* vsSrc = shaderSource.VertexSource.c_str();
-	GLCall(glShaderSource(vs, 1, &vsSrc, nullptr));
-	GLCall(glCompileShader(vs));
+    GLCall(GLuint shader = glCreateShader(type));
+	const char* src = source.c_str();
+	GLCall(glShaderSource(shader, 1, &src, nullptr));
+	GLCall(glCompileShader(shader));
 
 	int result;
-	GLCall(glGetShaderiv(vs, GL_COMPILE_STATUS, &result));
+	GLCall(glGetShaderiv(shader, GL_COMPILE_STATUS, &result));
 	if (result == GL_FALSE)
 	{
 		int length;
-		GLCall(glGetShaderiv(vs, GL_INFO_LOG_LENGTH, &length));
+		GLCall(glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &length));
 		char* message = (char*)alloca(length * sizeof(char));
-		GLCall(glGetShaderInfoLog(vs, length, &length, message));
-		std::cout << "Failed to compile vertex shader!" << std::endl;
+		GLCall(glGetShaderInfoLog(shader, length, &length, message));
+		std::cout << "Failed to compile " << name << " shader!" << std::endl;
 		std::cout << message << std::endl;
-		GLCall(glDeleteShader(vs));
+		GLCall(glDeleteShader(shader));
+		return 0;
 	}
+	return shader;
+}
 
-    GLCall(unsigned int fs = glCreateShader(GL_FRAGMENT_SHADER));
-	const char* fsSrc = shaderSource.FragmentSource.c_str();
-	GLCall(glShaderSource(fs, 1, &fsSrc, nullptr));
-	GLCall(glCompileShader(fs));
+void Shader::CompileShader(Shader::ShaderSource shaderSource)
+{
+	GLuint stages[4] = {
+		CompileStage(GL_VERTEX_SHADER, shaderSource.VertexSource, "vertex"),
+		CompileStage(GL_FRAGMENT_SHADER, shaderSource.FragmentSource, "fragment"),
+		0,
+		0
+	};
+	// Tessellation runs between the vertex and fragment stages when present
+	if (!shaderSource.TessControlSource.empty())
+	{
+		stages[2] = CompileStage(GL_TESS_CONTROL_SHADER, shaderSource.TessControlSource, "tessellation control");
+	}
+	if (!shaderSource.TessEvaluationSource.empty())
+	{
+		stages[3] = CompileStage(GL_TESS_EVALUATION_SHADER, shaderSource.TessEvaluationSource, "tessellation evaluation");
+	}
 
-	GLCall(glGetShaderiv(fs, GL_COMPILE_STATUS, &result));
+    GLCall(unsigned int program = glCreateProgram());
+
+	for (int i = 0; i < 4; i++)
+	{
+		if (stages[i] != 0)
+		{
+			GLCall(glAttachShader(program, stages[i]));
+		}
+	}
+	GLCall(glLinkProgram(program));
+
+	int result;
+	GLCall(glGetProgramiv(program, GL_LINK_STATUS, &result));
 	if (result == GL_FALSE)
 	{
 		int length;
-		GLCall(glGetShaderiv(fs, GL_INFO_LOG_LENGTH, &length));
+		GLCall(glGetProgramiv(program, GL_INFO_LOG_LENGTH, &length));
 		char* message = (char*)alloca(length * sizeof(char));
-		GLCall(glGetShaderInfoLog(fs, length, &length, message));
-		std::cout << "Failed to compile fragment shader!" << std::endl;
+		GLCall(glGetProgramInfoLog(program, length, &length, message));
+		std::cout << "Failed to link shader program!" << std::endl;
 		std::cout << message << std::endl;
-		GLCall(glDeleteShader(fs));
 	}
-
-    GLCall(unsigned int program = glCreateProgram());
-
-	GLCall(glAttachShader(program, vs));
-	GLCall(glAttachShader(program, fs));
-	GLCall(glLinkProgram(program));
 	GLCall(glValidateProgram(program));
 
-	GLCall(glDeleteShader(vs));
-	GLCall(glDeleteShader(fs));
+	for (int i = 0; i < 4; i++)
+	{
+		if (stages[i] != 0)
+		{
+			GLCall(glDeleteShader(stages[i]));
+		}
+	}
 	mID = program;
 }
 
@@ -22,139 +22,752 @@
  */
 
 #include "Terrain.h"
+#include "ThreadPool.h"
+
+// Share of the progress bar given to diamond-square, the rest is meshing
+static const float GENERATION_SHARE = 0.8f;
+// Quads per side of the CDLOD patch grid
+static const int CDLOD_PATCH_SIZE = 32;
+// Cells per side of a tessellation patch, at most the GL minimum of 64 segments per edge
+static const int TESSELLATION_PATCH_SIZE = 64;
+
+// Attributes of a TerrainVertex
+static VertexLayout GetTerrainVertexLayout()
+{
+    VertexLayout layout;
+    layout.Add(0, 3, GL_FLOAT).Add(1, 2, GL_SHORT, true);
+    return layout;
+}
+
+TerrainJob::TerrainJob(const unsigned char detailLevel, const float range, const unsigned int seed,
+    const TerrainRenderMode renderMode, const HeightFormat heightFormat, const IndexLayout indexLayout,
+    const int maxPreviewSize)
+    : mDetailLevel(detailLevel), mRange(range), mSeed(seed), mRenderMode(renderMode), mHeightFormat(heightFormat),
+      mIndexLayout(indexLayout), mMaxPreviewSize(maxPreviewSize),
+      mMinElevation(0.0f), mMaxElevation(0.0f), mQuantizationError(0.0f), mStagingSpan(nullptr), mStagingOffset(0),
+      mState(TerrainJobState::QUEUED), mGenerationProgress(0.0f)
+{
+
+}
+
+float TerrainJob::GetProgress() const
+{
+    switch(GetState())
+    {
+        case TerrainJobState::QUEUED:
+        case TerrainJobState::CANCELLED:
+            return 0.0f;
+        case TerrainJobState::GENERATING:
+            return GENERATION_SHARE*mGenerationProgress.load(std::memory_order_relaxed);
+        case TerrainJobState::MESHING:
+            return GENERATION_SHARE;
+        default:
+            return 1.0f;
+    }
+}
+
+void TerrainJob::SetState(const TerrainJobState state)
+{
+    std::lock_guard<std::mutex> lock(mMutex);
+    mState = state;
+    mCondition.notify_all();
+}
+
+void TerrainJob::WaitUntilReady()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    mCondition.wait(lock, [this] { return mState.load() >= TerrainJobState::READY; });
+}
 
 Terrain::Terrain()
+    : mPreviewMin(0.0f), mPreviewMax(0.0f), mPreviewVersion(0),
+      mIndexLayout(IndexLayout::TRIANGLE_LIST),
+      mRenderMode(TerrainRenderMode::VERTEX_ATTRIBUTES), mHeightFormat(HeightFormat::FLOAT32),
+      mDrawMode(TerrainRenderMode::VERTEX_ATTRIBUTES), mDrawFormat(HeightFormat::FLOAT32),
+      mQuantizationError(0.0f), mHeightBytes(0), mGridSize(0), mVertexBytes(0), mMaxPreviewSize(0), mShownPreviewVersion(0),
+      mViewEye(0.0f, 0.0f, 1.0f), mViewportHeight(600.0f), mViewFovY(60.0f), mCullStats(),
+      mInstanceCapacity(0), mLodPixelsPerQuad(2.0f), mPatchCount(0), mTessPixelsPerEdge(8.0f),
+      mRtinStats(), mRtinMaxError(0.002f)
 {
 
 }
 
 Terrain::~Terrain()
 {
+    // The worker writes into this terrain until its job is ready
+    if(mJob)
+    {
+        mJob->WaitUntilReady();
+    }
+}
 
+void Terrain::SetIndexLayout(const IndexLayout layout)
+{
+    mIndexLayout = layout;
+    if(mGridIndices && mGridIndices->layout != layout)
+    {
+        mGridIndices = GridIndexCache::Acquire(mGridIndices->gridSize, layout);
+        SetIndices(&mGridIndices->buffer);
+    }
+    if(mPatchIndices && mPatchIndices->layout != layout)
+    {
+        AcquirePatchIndices();
+    }
+}
+
+size_t Terrain::GetIndexBytes() const
+{
+    size_t bytes = mGridIndices ? mGridIndices->indices.size()*sizeof(unsigned int) : 0;
+    if(mDrawMode == TerrainRenderMode::TESSELLATION || mDrawMode == TerrainRenderMode::RTIN)
+    {
+        bytes += mIbo.GetSize();
+    }
+    if(mPatchIndices)
+    {
+        bytes += (mPatchIndices->indices.size() + mQuarterPatchIndices->indices.size())*sizeof(unsigned int);
+    }
+    return bytes;
+}
+
+void Terrain::SetView(const vmath::vec3& eye, const vmath::mat4& mvp, const float viewportHeight, const float fovY)
+{
+    mViewEye = eye;
+    mViewFrustum.Set(mvp);
+    mViewportHeight = viewportHeight;
+    mViewFovY = fovY;
+}
+
+void Terrain::SetRtinMaxError(const float maxError)
+{
+    mRtinMaxError = maxError;
+    if(mDrawMode == TerrainRenderMode::RTIN && !mRtin.IsEmpty())
+    {
+        UploadRtinMesh();
+    }
+}
+
+void Terrain::Release()
+{
+    if(mJob)
+    {
+        mJob->WaitUntilReady();
+        mJob->mGridIndices.reset();
+        mJob->SetState(TerrainJobState::CANCELLED);
+        mJob.reset();
+    }
+    if(mQueuedJob)
+    {
+        mQueuedJob->SetState(TerrainJobState::CANCELLED);
+        mQueuedJob.reset();
+    }
+    mGridIndices.reset();
+    mPatchIndices.reset();
+    mQuarterPatchIndices.reset();
+    mInstances.Release();
+    mInstanceCapacity = 0;
+    mQuadtree.Clear();
+    mPatchCount = 0;
+    mRtin.Clear();
+    mRtinIndices = std::vector<unsigned int>();
+    mVbo.Release();
+    mStaging.Release();
+    mIbo.Release();
+    mHeightTexture.Release();
+}
+
+void Terrain::GenTerrain(const unsigned char detailLevel, float range, const unsigned int seed)
+{
+    GenTerrainAsync(detailLevel, range, seed);
+    Finish();
+}
+
+std::shared_ptr<TerrainJob> Terrain::GenTerrainAsync(const unsigned char detailLevel, float range, const unsigned int seed)
+{
+    std::shared_ptr<TerrainJob> job(new TerrainJob(detailLevel, range, seed, mRenderMode, mHeightFormat, mIndexLayout, mMaxPreviewSize));
+    if(!mJob)
+    {
+        StartJob(job);
+        return job;
+    }
+    if(mQueuedJob)
+    {
+        mQueuedJob->SetState(TerrainJobState::CANCELLED);
+    }
+    mQueuedJob = job;
+    return job;
 }
 
-void Terrain::GenTerrain(const unsigned char detailLevel, float range)
-{
-    const int n = pow(2,detailLevel) + 1;   // DEM length
-    const int m = 6*pow(n-1,2);             // Index count
-    minElevation = 0.0f;                    // DEM min elevation
-    maxElevation = 0.0f;                    // DEM max elevation
-    srand(time(NULL));                      // Seed random number generator
-    float** map = genMap(n);                // Initialize heightmap
-    
-    // Set corners
-    map[0][0] = 0.0f;
-    map[0][n-1] = 0.0f;
-    map[n-1][0] = 0.0f;
-    map[n-1][n-1] = 0.0f;
-
-    // Generate heightmap using diamond-square alogrithm
-    // https://en.wikipedia.org/wiki/Diamond-square_algorithm
-    for(int sideLength = n-1; sideLength >= 2; sideLength /= 2, range /= 2)
-	{
-		int halfSide = sideLength/2;
-        // Diamond step
-		for(int x = 0; x < n-1; x += sideLength)
-	    {
-	    	for(int y = 0; y < n-1; y += sideLength)
-	    	{
-	    		double avg = map[x][y] + map[x+sideLength][y] + map[x][y+sideLength] + map[x+sideLength][y+sideLength];
-	    		avg /= 4.0;
-	    		map[x+halfSide][y+halfSide] = avg + fRand(-range, range);
-                if(map[x+halfSide][y+halfSide] < minElevation)
-                {
-                    minElevation = map[x+halfSide][y+halfSide];
-                }
-                else if(map[x+halfSide][y+halfSide] > maxElevation)
-                {
-                    maxElevation = map[x+halfSide][y+halfSide];
-                }
-	    	}
+bool Terrain::Update()
+{
+    if(!mJob)
+    {
+        return false;
+    }
+    if(mJob->GetState() != TerrainJobState::READY)
+    {
+        if(mJob->mMaxPreviewSize > 0)
+        {
+            UploadPreview();
         }
-        // Square step
-		for(int x = 0; x < n-1; x += halfSide)
-	    {
-	    	for(int y = (x+halfSide)%sideLength; y < n -1; y +=sideLength)
-	    	{
-	    		double avg = map[(x-halfSide+n-1)%(n-1)][y] +
-	    			map[(x+halfSide)%(n-1)][y] +
-	    			map[x][(y+halfSide)%(n-1)] +
-	    			map[x][(y-halfSide+n-1)%(n-1)];
-	    		avg /= 4.0 + fRand(-range, range);
-	    		map[x][y] = avg;
-
-	    		if(x == 0) map[n-1][y] = avg;
-	    		if(y == 0) map[x][n-1] = avg;
-
-                if(map[x][y] < minElevation)
-                {
-                    minElevation = map[x][y];
-                }
-                else if(map[x][y] > maxElevation)
-                {
-                    maxElevation = map[x][y];
-                }
-	    	}
+        return false;
+    }
+    Upload(*mJob);
+    mJob->mGridIndices.reset();
+    mJob->SetState(TerrainJobState::DONE);
+    mJob.reset();
+    if(mQueuedJob)
+    {
+        StartJob(mQueuedJob);
+        mQueuedJob.reset();
+    }
+    if(mRenderMode != TerrainRenderMode::VERTEX_ATTRIBUTES && (!mJob || mJob->mStagingSpan == nullptr))
+    {
+        // Kept across regenerations, and only dropped once the render mode
+        // no longer writes vertices. The copy just issued keeps its storage
+        // alive until it is done.
+        mStaging.Release();
+    }
+    return true;
+}
+
+void Terrain::Finish()
+{
+    while(mJob)
+    {
+        mJob->WaitUntilReady();
+        Update();
+    }
+}
+
+void Terrain::StartJob(const std::shared_ptr<TerrainJob>& job)
+{
+    const int n = (1 << job->mDetailLevel) + 1;   // DEM length
+    if(job->mRenderMode == TerrainRenderMode::VERTEX_ATTRIBUTES && RingBuffer::IsSupported())
+    {
+        // The span is reserved here, where GL calls are allowed, and written
+        // by the worker through the persistent mapping
+        const size_t bytes = (size_t)n*n*sizeof(TerrainVertex);
+        if(mStaging.GetSize() < 2*bytes)
+        {
+            // Two spans, so a queued job's reservation never waits on the
+            // copy Update has just issued from the other one
+            mStaging.Create(2*bytes);
         }
+        job->mStagingSpan = mStaging.Reserve(bytes);
+        job->mStagingOffset = mStaging.GetReservedOffset();
     }
-    
-    // Generate vertices
-    vmath::vec3* vertices = new vmath::vec3[n*n];
-    for(int i = 0; i < n; i++)
+
+    mJob = job;
+    job->SetState(TerrainJobState::GENERATING);
+    ThreadPool::GetShared().Enqueue([this, job]()
     {
-        float y = -(2.0f*((float)i/(float)(n - 1)) - 1.0f);
-        for(int j = 0; j < n; j++)
+        RunCpuPhase(*job);
+        job->SetState(TerrainJobState::READY);
+    });
+}
+
+void Terrain::RunCpuPhase(TerrainJob& job)
+{
+    const int n = (1 << job.mDetailLevel) + 1;   // DEM length
+    HeightField& map = mHeightField;            // Heightmap, reused between calls
+    const bool quantized = job.mRenderMode != TerrainRenderMode::VERTEX_ATTRIBUTES && job.mHeightFormat == HeightFormat::UNORM16;
+
+    // Generate heightmap
+    DiamondSquare& generator = mPipeline.GetGenerator();
+    generator.SetProgress(&job.mGenerationProgress);
+    if(job.mMaxPreviewSize > 0)
+    {
+        const int maxPreviewSize = job.mMaxPreviewSize;
+        generator.SetLevelCallback([this, maxPreviewSize](const HeightField& level, int sideLength)
         {
-            float x = 2.0f*((float)j/(float)(n - 1)) - 1.0f;
-            vertices[n*i + j] = vmath::vec3(x, y, map[j][i]);
+            PublishPreview(level, sideLength, maxPreviewSize);
+        });
+    }
+    mPipeline.Generate(map, job.mDetailLevel, job.mRange, job.mSeed);
+    generator.SetLevelCallback(DiamondSquare::LevelCallback());
+    generator.SetProgress(nullptr);
+    job.mMinElevation = mPipeline.GetMinElevation();
+    job.mMaxElevation = mPipeline.GetMaxElevation();
+    job.SetState(TerrainJobState::MESHING);
+    if(job.mRenderMode == TerrainRenderMode::CDLOD)
+    {
+        // Node bounds come from the full precision heights
+        mNextQuadtree.Build(map, CDLOD_PATCH_SIZE < n-1 ? CDLOD_PATCH_SIZE : n-1, mPipeline.GetThreadCount());
+    }
+    else if(job.mRenderMode == TerrainRenderMode::RTIN)
+    {
+        mNextRtin.Build(map, mPipeline.GetThreadCount());
+    }
+    else if(job.mRenderMode != TerrainRenderMode::TESSELLATION)
+    {
+        job.mGridIndices = GridIndexCache::Prepare(n, job.mIndexLayout);
+        ComputeTileBounds(map, job.mGridIndices->chunkSize, job.mChunkBounds, mPipeline.GetThreadCount());
+    }
+
+    if(quantized)
+    {
+        job.mQuantizationError = QuantizeHeights(map, job.mMinElevation, job.mMaxElevation, mQuantizedField, mPipeline.GetThreadCount());
+        // Only the 16-bit copy is kept between regenerations
+        mHeightField = HeightField();
+    }
+    else
+    {
+        mQuantizedField = QuantizedHeightField();
+    }
+
+    if(job.mRenderMode == TerrainRenderMode::VERTEX_ATTRIBUTES)
+    {
+        // Generate vertices, straight into mapped memory when there is a span
+        TerrainVertex* vertices = (TerrainVertex*)job.mStagingSpan;
+        if(vertices == nullptr)
+        {
+            mVertices.resize((size_t)n*n);
+            vertices = mVertices.data();
         }
+        mPipeline.BuildVertices(map, vertices);
+
+        // Normal vectors for lighting
+        mNormals.resize((size_t)n*n);
+        mPipeline.ComputeNormals(map, mNormals.data(), vertices);
     }
+}
 
-    // Order to render vertices
-    unsigned int* indices = new unsigned int[m];
-    for(int i = 0; i < n-1; i++)
+void Terrain::PublishPreview(const HeightField& map, const int sideLength, const int maxPreviewSize)
+{
+    // Every cell on a grid of sideLength/2 is final
+    const int step = sideLength/2;
+    const int n = (map.GetWidth() - 1)/step + 1;
+    if(n > maxPreviewSize || step < 1)
     {
-        for(int j = 0; j < n-1; j++)
+        return;
+    }
+
+    HeightField preview(n, n);
+    float lo = map(0, 0), hi = map(0, 0);
+    for(int y = 0; y < n; y++)
+    {
+        const float* row = map.Row(y*step);
+        float* out = preview.Row(y);
+        for(int x = 0; x < n; x++)
         {
-            indices[6*(n-1)*i+6*j+0] = n + j + i*n;
-            indices[6*(n-1)*i+6*j+1] = 0 + j + i*n;
-            indices[6*(n-1)*i+6*j+2] = 1 + j + i*n;
-            indices[6*(n-1)*i+6*j+3] = 1 + j + i*n;
-            indices[6*(n-1)*i+6*j+4] = n+1 + j + i*n;
-            indices[6*(n-1)*i+6*j+5] = n + j + i*n;
+            float h = row[x*step];
+            out[x] = h;
+            lo = h < lo ? h : lo;
+            hi = h > hi ? h : hi;
         }
     }
 
-    // Normal vectors for lighting
-    vmath::vec3* faceNormals = new vmath::vec3[m/3];
-    for(int i = 0; i < m/3; i++)
+    std::lock_guard<std::mutex> lock(mPreviewMutex);
+    mPreview = std::move(preview);
+    mPreviewMin = lo;
+    mPreviewMax = hi;
+    mPreviewVersion++;
+}
+
+bool Terrain::UploadPreview()
+{
+    std::lock_guard<std::mutex> lock(mPreviewMutex);
+    if(mPreviewVersion == mShownPreviewVersion || mPreview.GetWidth() == 0)
+    {
+        return false;
+    }
+    mShownPreviewVersion = mPreviewVersion;
+
+    // Drawn like a small height texture terrain
+    const int n = mPreview.GetWidth();
+    mHeightTexture.CreateTexture(GL_R32F, n, n, GL_RED, GL_FLOAT, mPreview.GetData(), mPreview.GetPitch());
+    DisableVerticies(0);
+    DisableVerticies(1);
+    DisableVerticies(2);
+    DisableVerticies(3);
+    if(!mGridIndices || mGridIndices->gridSize != n || mGridIndices->layout != mIndexLayout)
+    {
+        mGridIndices = GridIndexCache::Acquire(n, mIndexLayout);
+    }
+    SetIndices(&mGridIndices->buffer);
+    // Previews are small, they are drawn whole
+    mChunkBounds.clear();
+    minElevation = mPreviewMin;
+    maxElevation = mPreviewMax;
+    mGridSize = n;
+    mDrawMode = TerrainRenderMode::HEIGHT_TEXTURE;
+    mDrawFormat = HeightFormat::FLOAT32;
+    return true;
+}
+
+void Terrain::Upload(TerrainJob& job)
+{
+    const int n = (1 << job.mDetailLevel) + 1;   // DEM length
+
+    if(job.mRenderMode != TerrainRenderMode::VERTEX_ATTRIBUTES && job.mHeightFormat == HeightFormat::UNORM16)
+    {
+        mHeightTexture.CreateTexture(GL_R16, n, n, GL_RED, GL_UNSIGNED_SHORT, mQuantizedField.GetData(), mQuantizedField.GetPitch());
+        mVertexBytes = (size_t)n*n*sizeof(uint16_t);
+        DisableVerticies(0);
+        DisableVerticies(1);
+        mVbo.Release();
+    }
+    else if(job.mRenderMode != TerrainRenderMode::VERTEX_ATTRIBUTES)
+    {
+        // The heightmap is the whole mesh, the shader rebuilds the rest
+        mHeightTexture.CreateTexture(GL_R32F, n, n, GL_RED, GL_FLOAT, mHeightField.GetData(), mHeightField.GetPitch());
+        mVertexBytes = (size_t)n*n*sizeof(float);
+        DisableVerticies(0);
+        DisableVerticies(1);
+        mVbo.Release();
+    }
+    else
+    {
+        UploadVertexBuffer(job, n);
+        mHeightTexture.Release();
+    }
+
+    if(job.mRenderMode == TerrainRenderMode::CDLOD)
+    {
+        // Patches are placed by per-instance nodes, Render fills them in
+        std::swap(mQuadtree, mNextQuadtree);
+        mNextQuadtree.Clear();
+        if(mInstanceCapacity == 0)
+        {
+            mInstanceCapacity = 256;
+            mInstances.CreateBuffer(nullptr, mInstanceCapacity, sizeof(CdlodNode));
+        }
+        VertexLayout instanceLayout;
+        instanceLayout.Add(2, 4, GL_FLOAT).Add(3, 2, GL_FLOAT);
+        SetInstances(&mInstances, instanceLayout);
+        mGridIndices.reset();
+        mRtin.Clear();
+        AcquirePatchIndices();
+    }
+    else if(job.mRenderMode == TerrainRenderMode::TESSELLATION)
+    {
+        // No full resolution buffers, the patches are refined on the GPU
+        DisableVerticies(2);
+        DisableVerticies(3);
+        mQuadtree.Clear();
+        mChunkBounds.clear();
+        mGridIndices.reset();
+        mPatchIndices.reset();
+        mQuarterPatchIndices.reset();
+        mRtin.Clear();
+        UploadPatchGrid(n);
+    }
+    else if(job.mRenderMode == TerrainRenderMode::RTIN)
     {
-        faceNormals[i] = vmath::cross(vertices[indices[3*i+2]] - vertices[indices[3*i]], vertices[indices[3*i+1]] - vertices[indices[3*i]]);
+        // The full grid's vertices come from the height texture, only the
+        // triangles that are needed are indexed
+        DisableVerticies(2);
+        DisableVerticies(3);
+        mQuadtree.Clear();
+        mChunkBounds.clear();
+        mGridIndices.reset();
+        mPatchIndices.reset();
+        mQuarterPatchIndices.reset();
+        std::swap(mRtin, mNextRtin);
+        mNextRtin.Clear();
+        UploadRtinMesh();
     }
-    // TODO: average face normals per vertex
-    vmath::vec3* vertexNormals = new vmath::vec3[n*n];
-    for(int i = 0; i < m/3; i++)
+    else
     {
-        vertexNormals[indices[3*i]] = faceNormals[i];
-        vertexNormals[indices[3*i+1]] = faceNormals[i];
-        vertexNormals[indices[3*i+2]] = faceNormals[i];
+        DisableVerticies(2);
+        DisableVerticies(3);
+        mQuadtree.Clear();
+        mRtin.Clear();
+        mChunkBounds.swap(job.mChunkBounds);
+        mPatchIndices.reset();
+        mQuarterPatchIndices.reset();
+
+        // Index buffer shared by every terrain of this size. The layout may
+        // have changed since the job prepared its indices.
+        if(!mGridIndices || mGridIndices->gridSize != n || mGridIndices->layout != mIndexLayout)
+        {
+            mGridIndices = GridIndexCache::Acquire(n, mIndexLayout);
+        }
+        SetIndices(&mGridIndices->buffer);
     }
 
-    // Buffer data
-    mVbo.CreateBuffer(vertices, n*n, sizeof(vmath::vec3));
-    mNbo.CreateBuffer(vertexNormals, n*n, sizeof(vmath::vec3));
-    mIbo.CreateBuffer(indices, m);
-    // Clean up
-    delete[] vertices;
-    delete[] faceNormals;
-    delete[] vertexNormals;
-    delete[] indices;
-    for(int i = 0; i < n; i++)
+    // Everything the shader reads changes in the same frame
+    minElevation = job.mMinElevation;
+    maxElevation = job.mMaxElevation;
+    mQuantizationError = job.mQuantizationError;
+    // The worker is done with the heightmaps until the next job starts
+    mHeightBytes = mHeightField.GetSizeInBytes() + mQuantizedField.GetSizeInBytes();
+    mGridSize = n;
+    mDrawMode = job.mRenderMode;
+    mDrawFormat = job.mHeightFormat;
+    if(mDrawMode != TerrainRenderMode::TESSELLATION)
     {
-        delete[] map[i];
+        mPatchCount = 0;
+    }
+
+    // Previews of this job that were never shown are stale now
+    std::lock_guard<std::mutex> lock(mPreviewMutex);
+    mShownPreviewVersion = mPreviewVersion;
+    mPreview = HeightField();
+}
+
+void Terrain::UploadVertexBuffer(const TerrainJob& job, const int n)
+{
+    const VertexLayout layout = GetTerrainVertexLayout();
+
+    if(job.mStagingSpan != nullptr)
+    {
+        // Copied on the GPU from the span the worker filled
+        mVbo.CopyBuffer(mStaging.GetID(), job.mStagingOffset, n*n, layout.GetStride());
+        mStaging.Commit();
+    }
+    else
+    {
+        mVbo.CreateBuffer(mVertices.data(), n*n, layout.GetStride());
     }
     // Create vertex array object
-    SetVerticies(&mVbo, 0);
-    SetVerticies(&mNbo, 1);
+    SetVerticies(&mVbo, layout);
+    mVertexBytes = (size_t)n*n*layout.GetStride();
+}
+
+void Terrain::UploadMesh(const TerrainMesh& mesh, const float minHeight, const float maxHeight)
+{
+    const int n = mesh.gridSize;
+    const VertexLayout layout = GetTerrainVertexLayout();
+    mVbo.CreateBuffer(mesh.vertices.data(), n*n, layout.GetStride());
+    SetVerticies(&mVbo, layout);
+    DisableVerticies(2);
+    DisableVerticies(3);
+    mHeightTexture.Release();
+    mQuadtree.Clear();
+    mRtin.Clear();
+    mChunkBounds.clear();
+    mPatchIndices.reset();
+    mQuarterPatchIndices.reset();
+    if(!mGridIndices || mGridIndices->gridSize != n || mGridIndices->layout != mesh.layout)
+    {
+        mGridIndices = GridIndexCache::Acquire(n, mesh.layout);
+    }
+    SetIndices(&mGridIndices->buffer);
+    if(!mJob)
+    {
+        // Heights of the last generation, which no longer match the mesh
+        mHeightField = HeightField();
+        mHeightBytes = mQuantizedField.GetSizeInBytes();
+    }
+
+    minElevation = minHeight;
+    maxElevation = maxHeight;
+    mQuantizationError = 0.0f;
+    mVertexBytes = (size_t)n*n*layout.GetStride();
+    mGridSize = n;
+    mDrawMode = TerrainRenderMode::VERTEX_ATTRIBUTES;
+    mDrawFormat = HeightFormat::FLOAT32;
+    mPatchCount = 0;
+}
+
+bool Terrain::Export(const std::string& path, const HeightFileFormat format) const
+{
+    if(mJob)
+    {
+        std::cout << "Cannot export while a terrain is generating" << std::endl;
+        return false;
+    }
+    if(mHeightField.GetWidth() == 0)
+    {
+        std::cout << "No 32-bit heightmap to export" << std::endl;
+        return false;
+    }
+    HeightFieldWriter writer;
+    return writer.Write(path, mHeightField, format, minElevation, maxElevation);
+}
+
+void Terrain::AcquirePatchIndices()
+{
+    const int patchSize = mQuadtree.GetPatchSize();
+    mPatchIndices = GridIndexCache::Acquire(patchSize + 1, mIndexLayout);
+    mQuarterPatchIndices = GridIndexCache::Acquire(patchSize/2 + 1, mIndexLayout);
+}
+
+void Terrain::UploadPatchGrid(const int n)
+{
+    const int patchSize = TESSELLATION_PATCH_SIZE < n-1 ? TESSELLATION_PATCH_SIZE : n-1;
+    const int m = (n - 1)/patchSize;    // Patches per side
+    std::vector<float> corners;
+    corners.reserve(2*(size_t)(m + 1)*(m + 1));
+    for(int i = 0; i <= m; i++)
+    {
+        for(int j = 0; j <= m; j++)
+        {
+            corners.push_back((float)(j*patchSize));
+            corners.push_back((float)(i*patchSize));
+        }
+    }
+    std::vector<unsigned int> indices;
+    indices.reserve(4*(size_t)m*m);
+    for(int i = 0; i < m; i++)
+    {
+        for(int j = 0; j < m; j++)
+        {
+            // Corner order tessellation.glsl expects
+            const unsigned int k = i*(m + 1) + j;
+            indices.push_back(k);
+            indices.push_back(k + 1);
+            indices.push_back(k + m + 2);
+            indices.push_back(k + m + 1);
+        }
+    }
+
+    VertexLayout layout;
+    layout.Add(0, 2, GL_FLOAT);
+    mVbo.CreateBuffer(corners.data(), (m + 1)*(m + 1), layout.GetStride());
+    SetVerticies(&mVbo, layout);
+    mIbo.CreateBuffer(indices.data(), (unsigned int)indices.size());
     SetIndices(&mIbo);
+    mVertexBytes += mVbo.GetSize();
+    mPatchCount = m*m;
+}
+
+void Terrain::UploadRtinMesh()
+{
+    mRtin.Extract(mRtinMaxError, mRtinIndices, &mRtinStats);
+    mIbo.CreateBuffer(mRtinIndices.data(), (unsigned int)mRtinIndices.size());
+    SetIndices(&mIbo);
+}
+
+void Terrain::Render(Shader* shader)
+{
+    const bool fromTexture = mDrawMode != TerrainRenderMode::VERTEX_ATTRIBUTES;
+    shader->Bind();
+    if(fromTexture)
+    {
+        mHeightTexture.Bind(0);
+    }
+    glUniform1i(6, fromTexture ? 1 : 0);
+    glUniform1i(7, mGridSize);
+    glUniform1i(8, mDrawFormat == HeightFormat::UNORM16 ? 1 : 0);
+    glUniform2f(9, 0.0f, 0.0f);
+    if(mDrawMode == TerrainRenderMode::CDLOD)
+    {
+        RenderLod(shader);
+        return;
+    }
+    if(mDrawMode == TerrainRenderMode::TESSELLATION)
+    {
+        RenderPatches(shader);
+        return;
+    }
+    glUniform1i(10, 0);
+    if(mDrawMode == TerrainRenderMode::RTIN)
+    {
+        mCullStats = TerrainCullStats();
+        Mesh::Render(shader, GL_TRIANGLES);
+        return;
+    }
+    RenderChunks(shader);
+}
+
+void Terrain::RenderChunks(Shader* shader)
+{
+    mCullStats = TerrainCullStats();
+    if(!mGridIndices)
+    {
+        return;
+    }
+    const GridIndices& grid = *mGridIndices;
+    const int m = grid.chunksPerSide;
+    const size_t chunkTriangles = 2*(size_t)grid.chunkSize*grid.chunkSize;
+    if(mChunkBounds.size() != (size_t)m*m)
+    {
+        Mesh::Render(shader, grid.primitive);
+        mCullStats.drawnChunks = m*m;
+        mCullStats.drawnTriangles = (size_t)m*m*chunkTriangles;
+        return;
+    }
+
+    // Boxes from each chunk's own elevation range, in model space
+    const float size = grid.chunkSize*2.0f/(float)(grid.gridSize - 1);
+    mDrawCounts.clear();
+    mDrawOffsets.clear();
+    int lastDrawn = -2;
+    for(int cy = 0; cy < m; cy++)
+    {
+        for(int cx = 0; cx < m; cx++)
+        {
+            const int k = cy*m + cx;
+            const ElevationBounds& bounds = mChunkBounds[k];
+            vmath::vec3 boxMin(cx*size - 1.0f, 1.0f - (cy + 1)*size, bounds.minElevation);
+            vmath::vec3 boxMax((cx + 1)*size - 1.0f, 1.0f - cy*size, bounds.maxElevation);
+            if(!mViewFrustum.Intersects(boxMin, boxMax))
+            {
+                mCullStats.culledChunks++;
+                continue;
+            }
+            mCullStats.drawnChunks++;
+            // Consecutive visible chunks are consecutive in the index buffer
+            if(k == lastDrawn + 1)
+            {
+                mDrawCounts.back() += (GLsizei)grid.chunkIndexCount;
+            }
+            else
+            {
+                mDrawCounts.push_back((GLsizei)grid.chunkIndexCount);
+                mDrawOffsets.push_back((const void*)(k*grid.chunkIndexCount*sizeof(unsigned int)));
+            }
+            lastDrawn = k;
+        }
+    }
+    mCullStats.drawnTriangles = mCullStats.drawnChunks*chunkTriangles;
+    mCullStats.culledTriangles = mCullStats.culledChunks*chunkTriangles;
+    if(!mDrawCounts.empty())
+    {
+        RenderRanges(shader, grid.primitive, mDrawCounts.data(), mDrawOffsets.data(), (GLsizei)mDrawCounts.size());
+    }
+}
+
+void Terrain::RenderLod(Shader* shader)
+{
+    mQuadtree.SetLodRanges(mQuadtree.GetFinestRangeFor(mLodPixelsPerQuad, mViewportHeight, mViewFovY));
+    mQuadtree.Select(mViewEye, mViewFrustum, mSelection);
+    const unsigned int whole = (unsigned int)mSelection.nodes.size();
+    const unsigned int quarters = (unsigned int)mSelection.quarterNodes.size();
+    if(whole + quarters == 0)
+    {
+        return;
+    }
+
+    // One instance buffer, grown to the largest selection seen
+    if(whole + quarters > mInstanceCapacity)
+    {
+        while(mInstanceCapacity < whole + quarters)
+        {
+            mInstanceCapacity *= 2;
+        }
+        mInstances.CreateBuffer(nullptr, mInstanceCapacity, sizeof(CdlodNode));
+    }
+    mInstances.UpdateBuffer(mSelection.nodes.data(), 0, whole*sizeof(CdlodNode));
+    mInstances.UpdateBuffer(mSelection.quarterNodes.data(), whole*sizeof(CdlodNode), quarters*sizeof(CdlodNode));
+
+    const int patchSize = mQuadtree.GetPatchSize();
+    glUniform3fv(11, 1, mViewEye);
+    if(whole > 0)
+    {
+        glUniform1i(10, patchSize);
+        SetIndices(&mPatchIndices->buffer);
+        RenderInstanced(shader, mPatchIndices->primitive, whole, 0);
+    }
+    if(quarters > 0)
+    {
+        glUniform1i(10, patchSize/2);
+        SetIndices(&mQuarterPatchIndices->buffer);
+        RenderInstanced(shader, mQuarterPatchIndices->primitive, quarters, whole);
+    }
+    glUniform1i(10, 0);
+}
+
+void Terrain::RenderPatches(Shader* shader)
+{
+    // A length l at distance d covers l*viewportHeight/(2*d*tan(fovY/2)) pixels
+    const float halfAngle = 0.5f*mViewFovY*(float)M_PI/180.0f;
+    mCullStats = TerrainCullStats();
+    glUniform3fv(11, 1, mViewEye);
+    glUniform1f(12, mViewportHeight/(2.0f*tanf(halfAngle)));
+    glUniform1f(13, mTessPixelsPerEdge);
+    GLCall( glPatchParameteri(GL_PATCH_VERTICES, 4) );
+    Mesh::Render(shader, GL_PATCHES);
 }
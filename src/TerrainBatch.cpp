@@ -0,0 +1,213 @@
+/*
+ * Copyright (c) 2018 Brendan Barnes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "TerrainBatch.h"
+#include "TerrainPipeline.h"
+#include "ThreadPool.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    // Heightmap of one terrain on its way to disk
+    struct BatchBuffer
+    {
+        HeightField map;
+        uint32_t seed;
+        unsigned char detailLevel;
+        float minElevation;
+        float maxElevation;
+        bool queued;    // Waiting for or being written, guarded by BatchQueue::mutex
+    };
+
+    // Reused by one worker for every terrain it generates
+    struct BatchArena
+    {
+        TerrainPipeline pipeline;
+        std::vector<BatchBuffer> buffers;
+        size_t next;            // Buffer of the next terrain, round robin
+        double stallSeconds;
+    };
+
+    // Finished heightmaps in the order they were generated
+    struct BatchQueue
+    {
+        std::mutex mutex;
+        std::condition_variable ready;      // A buffer was queued, or the run is over
+        std::condition_variable written;    // A buffer is free again
+        std::deque<BatchBuffer*> buffers;
+        bool finished;
+        size_t peakQueued;
+    };
+}
+
+TerrainBatch::TerrainBatch()
+    : mDirectory("."), mFormat(HeightFileFormat::RAW_FLOAT32), mDirectIO(false), mMinLevel(8), mMaxLevel(8), mFirstSeed(1), mSeedCount(1), mRange(0.7f),
+      mWorkerCount(0), mBuffersPerWorker(2), mWriteBufferSize(4 << 20)
+{
+
+}
+
+unsigned int TerrainBatch::GetWorkerCount() const
+{
+    if(mWorkerCount != 0)
+    {
+        return mWorkerCount;
+    }
+    const unsigned int threads = std::thread::hardware_concurrency();
+    return threads > 0 ? threads : 1;
+}
+
+TerrainBatchStats TerrainBatch::Run()
+{
+    TerrainBatchStats stats = TerrainBatchStats();
+    const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    const unsigned int workerCount = GetWorkerCount();
+    const size_t jobCount = GetJobCount();
+    const int levelCount = mMaxLevel - mMinLevel + 1;
+
+    std::vector<std::unique_ptr<BatchArena>> arenas(workerCount);
+    for(unsigned int i = 0; i < workerCount; i++)
+    {
+        arenas[i].reset(new BatchArena());
+        arenas[i]->pipeline.SetThreadCount(1);
+        arenas[i]->buffers.resize(mBuffersPerWorker);
+        arenas[i]->next = 0;
+        arenas[i]->stallSeconds = 0.0;
+        for(int j = 0; j < mBuffersPerWorker; j++)
+        {
+            arenas[i]->buffers[j].queued = false;
+        }
+    }
+
+    BatchQueue queue;
+    queue.finished = false;
+    queue.peakQueued = 0;
+
+    // The writer drains the queue until the workers are done and it is empty
+    std::thread writer([&]()
+    {
+        HeightFieldWriter fileWriter;
+        fileWriter.SetBufferSize(mWriteBufferSize);
+        fileWriter.SetDirectIO(mDirectIO);
+        char name[64];
+        while(true)
+        {
+            BatchBuffer* buffer;
+            {
+                std::unique_lock<std::mutex> lock(queue.mutex);
+                queue.ready.wait(lock, [&queue]() { return queue.finished || !queue.buffers.empty(); });
+                if(queue.buffers.empty())
+                {
+                    return;
+                }
+                buffer = queue.buffers.front();
+                queue.buffers.pop_front();
+            }
+
+            snprintf(name, sizeof(name), "/dem_%u_%u.%s", buffer->seed, buffer->detailLevel, HeightFieldWriter::GetExtension(mFormat));
+            const std::string path = mDirectory + name;
+            if(fileWriter.Write(path, buffer->map, mFormat, buffer->minElevation, buffer->maxElevation))
+            {
+                stats.terrains++;
+                stats.bytes += (size_t)buffer->map.GetWidth()*buffer->map.GetHeight()*HeightFieldWriter::GetBytesPerHeight(mFormat);
+            }
+            else
+            {
+                stats.failed++;
+            }
+
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            buffer->queued = false;
+            queue.written.notify_all();
+        }
+    });
+
+    // One band per arena. Workers take the next job until none are left, so
+    // a band that starts late only finds fewer of them.
+    std::atomic<size_t> nextJob(0);
+    ThreadPool pool(workerCount > 1 ? workerCount - 1 : 1);
+    pool.ParallelFor(workerCount, workerCount, [&](int first, int last)
+    {
+        for(int w = first; w < last; w++)
+        {
+            BatchArena& arena = *arenas[w];
+            size_t job;
+            while((job = nextJob.fetch_add(1)) < jobCount)
+            {
+                BatchBuffer& buffer = arena.buffers[arena.next];
+                arena.next = (arena.next + 1)%arena.buffers.size();
+                {
+                    // Back-pressure: wait until the writer is done with it
+                    std::unique_lock<std::mutex> lock(queue.mutex);
+                    if(buffer.queued)
+                    {
+                        const std::chrono::steady_clock::time_point stall = std::chrono::steady_clock::now();
+                        queue.written.wait(lock, [&buffer]() { return !buffer.queued; });
+                        std::chrono::duration<double> waited = std::chrono::steady_clock::now() - stall;
+                        arena.stallSeconds += waited.count();
+                    }
+                }
+
+                buffer.seed = mFirstSeed + (uint32_t)(job/levelCount);
+                buffer.detailLevel = (unsigned char)(mMinLevel + job%levelCount);
+                arena.pipeline.Generate(buffer.map, buffer.detailLevel, mRange, buffer.seed);
+                buffer.minElevation = arena.pipeline.GetMinElevation();
+                buffer.maxElevation = arena.pipeline.GetMaxElevation();
+
+                std::lock_guard<std::mutex> lock(queue.mutex);
+                buffer.queued = true;
+                queue.buffers.push_back(&buffer);
+                queue.peakQueued = queue.buffers.size() > queue.peakQueued ? queue.buffers.size() : queue.peakQueued;
+                queue.ready.notify_one();
+            }
+        }
+    });
+
+    {
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.finished = true;
+        queue.ready.notify_one();
+    }
+    writer.join();
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    stats.seconds = elapsed.count();
+    stats.peakQueued = queue.peakQueued;
+    for(unsigned int i = 0; i < workerCount; i++)
+    {
+        stats.stallSeconds += arenas[i]->stallSeconds;
+        for(size_t j = 0; j < arenas[i]->buffers.size(); j++)
+        {
+            stats.bufferBytes += arenas[i]->buffers[j].map.GetSizeInBytes();
+        }
+    }
+    return stats;
+}
@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2018 Brendan Barnes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "TerrainPipeline.h"
+#include "ThreadPool.h"
+#include "VertexNormals.h"
+#include "VertexPacking.h"
+
+void TerrainPipeline::Generate(HeightField& map, const unsigned char detailLevel, const float range, const uint32_t seed)
+{
+    mGenerator.Generate(map, detailLevel, range, seed);
+}
+
+void TerrainPipeline::BuildMesh(HeightFieldView<const float> map, const IndexLayout layout, TerrainMesh& mesh) const
+{
+    const int n = map.GetWidth();
+    mesh.gridSize = n;
+    mesh.layout = layout;
+    mesh.vertices.resize((size_t)n*n);
+    BuildVertices(map, mesh.vertices.data());
+    mesh.indices.resize(GetGridIndexCount(n, layout));
+    BuildGridIndices(n, layout, mesh.indices.data());
+}
+
+void TerrainPipeline::BuildVertices(HeightFieldView<const float> map, TerrainVertex* vertices) const
+{
+    const int n = map.GetWidth();
+    ThreadPool::SharedParallelFor(n, GetThreadCount(), [&](int first, int last)
+    {
+        for(int i = first; i < last; i++)
+        {
+            const float* row = map.Row(i);
+            float y = -(2.0f*((float)i/(float)(n - 1)) - 1.0f);
+            TerrainVertex* out = vertices + (size_t)n*i;
+            for(int j = 0; j < n; j++)
+            {
+                out[j].x = 2.0f*((float)j/(float)(n - 1)) - 1.0f;
+                out[j].y = y;
+                out[j].z = row[j];
+                out[j].normal = 0;
+            }
+        }
+    });
+}
+
+void TerrainPipeline::ComputeNormals(HeightFieldView<const float> map, TerrainMesh& mesh) const
+{
+    const int n = map.GetWidth();
+    mesh.normals.resize((size_t)n*n);
+    ComputeNormals(map, mesh.normals.data(), mesh.vertices.size() == (size_t)n*n ? mesh.vertices.data() : nullptr);
+}
+
+void TerrainPipeline::ComputeNormals(HeightFieldView<const float> map, vmath::vec3* normals, TerrainVertex* vertices) const
+{
+    const int n = map.GetWidth();
+    if(n < 2)
+    {
+        return;
+    }
+    ComputeVertexNormals(map, 2.0f/(float)(n - 1), normals, GetThreadCount());
+    if(vertices == nullptr)
+    {
+        return;
+    }
+    ThreadPool::SharedParallelFor(n, GetThreadCount(), [&](int first, int last)
+    {
+        for(size_t k = (size_t)first*n; k < (size_t)last*n; k++)
+        {
+            const vmath::vec3& normal = normals[k];
+            vertices[k].normal = PackOctahedral(normal[0], normal[1], normal[2]);
+        }
+    });
+}
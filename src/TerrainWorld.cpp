@@ -0,0 +1,436 @@
+/*
+ * Copyright (c) 2018 Brendan Barnes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+#include "TerrainWorld.h"
+#include "DiamondSquare.h"
+#include "ThreadPool.h"
+#include "Random.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Kinds of world lattice feature, each hashed with its own key
+enum WorldKey
+{
+    CORNER_KEY = 0,         // Height of a chunk corner
+    ROW_EDGE_KEY = 1,       // Edge along a chunk's first row
+    COLUMN_EDGE_KEY = 2,    // Edge along a chunk's first column
+    CHUNK_KEY = 3           // Seed of a chunk's interior
+};
+
+static inline uint32_t WorldFeatureKey(uint32_t seed, WorldKey kind, int x, int y)
+{
+    return HashCell(HashRowKey(HashLevelKey(seed, kind), (uint32_t)y), (uint32_t)x);
+}
+
+// 1D midpoint displacement between out[0] and out[(n-1)*step], which must
+// be set. Offsets shrink level by level like diamond-square's. Only half of
+// diamond-square's cells get an additive offset, the square step scales
+// instead, so edges use half the range to be about as rough as the interior.
+static void GenerateEdge(float* out, const size_t step, const int n, const unsigned char detailLevel, float range, const uint32_t edgeKey)
+{
+    for(int sideLength = n-1, level = detailLevel; sideLength >= 2; sideLength /= 2, range /= 2, level--)
+    {
+        const int halfSide = sideLength/2;
+        const uint32_t rowKey = HashRowKey(HashLevelKey(edgeKey, level), 0);
+        for(int x = halfSide; x < n; x += sideLength)
+        {
+            float offset = HashToRange(HashCell(rowKey, x), -0.5f*range, 0.5f*range);
+            out[x*step] = 0.5f*(out[(x-halfSide)*step] + out[(x+halfSide)*step]) + offset;
+        }
+    }
+}
+
+// Neighbour across each TerrainChunk::Side. Opposite sides differ in the low bit.
+static const int SIDE_DX[4] = { 0, 0, -1, 1 };
+static const int SIDE_DY[4] = { -1, 1, 0, 0 };
+
+// Height depth samples in from side, at position k along it
+static inline float SideHeight(const HeightField& map, const int side, const int k, const int depth)
+{
+    const int n = map.GetWidth();
+    switch(side)
+    {
+    case TerrainChunk::TOP: return map(k, depth);
+    case TerrainChunk::BOTTOM: return map(k, n-1 - depth);
+    case TerrainChunk::LEFT: return map(depth, k);
+    default: return map(n-1 - depth, k);
+    }
+}
+
+// First texel of side's apron in an (n+2)^2 chunk texture, and its direction
+static inline void GetApron(const int side, const int n, int& x, int& y, int& dx, int& dy)
+{
+    x = side == TerrainChunk::LEFT ? 0 : side == TerrainChunk::RIGHT ? n + 1 : 1;
+    y = side == TerrainChunk::TOP ? 0 : side == TerrainChunk::BOTTOM ? n + 1 : 1;
+    dx = side <= TerrainChunk::BOTTOM ? 1 : 0;
+    dy = 1 - dx;
+}
+
+TerrainWorld::TerrainWorld(const unsigned char detailLevel, const float range, const unsigned int seed)
+    : mDetailLevel(detailLevel), mRange(range), mSeed(seed), mGridSize((1 << detailLevel) + 1),
+      mViewRadius(3), mCpuBudget(32u << 20), mGpuBudget(16u << 20), mMaxPending(8), mUploadsPerUpdate(4),
+      mMinElevation(0.0f), mMaxElevation(0.0f), mCenterX(0), mCenterY(0),
+      mIndexLayout(IndexLayout::TRIANGLE_LIST), mStats()
+{
+
+}
+
+void TerrainWorld::GenerateChunk(HeightField& map, const unsigned char detailLevel, const float range, const unsigned int seed,
+    const int x, const int y, float& minElevation, float& maxElevation)
+{
+    const int n = (1 << detailLevel) + 1;   // DEM length
+    map.Allocate(n, n);
+
+    // Corners are shared by four chunks and edges by two, so both only
+    // depend on their world position
+    map(0, 0) = HashToRange(WorldFeatureKey(seed, CORNER_KEY, x, y), -range, range);
+    map(n-1, 0) = HashToRange(WorldFeatureKey(seed, CORNER_KEY, x+1, y), -range, range);
+    map(0, n-1) = HashToRange(WorldFeatureKey(seed, CORNER_KEY, x, y+1), -range, range);
+    map(n-1, n-1) = HashToRange(WorldFeatureKey(seed, CORNER_KEY, x+1, y+1), -range, range);
+    const size_t pitch = map.GetPitch();
+    GenerateEdge(map.Row(0), 1, n, detailLevel, range, WorldFeatureKey(seed, ROW_EDGE_KEY, x, y));
+    GenerateEdge(map.Row(n-1), 1, n, detailLevel, range, WorldFeatureKey(seed, ROW_EDGE_KEY, x, y+1));
+    GenerateEdge(map.Row(0), pitch, n, detailLevel, range, WorldFeatureKey(seed, COLUMN_EDGE_KEY, x, y));
+    GenerateEdge(map.Row(0) + n-1, pitch, n, detailLevel, range, WorldFeatureKey(seed, COLUMN_EDGE_KEY, x+1, y));
+
+    // Chunks are generated side by side, one thread each
+    DiamondSquare generator;
+    generator.SetThreadCount(1);
+    generator.GenerateInterior(map, detailLevel, range, WorldFeatureKey(seed, CHUNK_KEY, x, y));
+    minElevation = generator.GetMinElevation();
+    maxElevation = generator.GetMaxElevation();
+}
+
+std::pair<int, int> TerrainWorld::GetChunkAt(const float x, const float y)
+{
+    return std::make_pair((int)std::floor((x + 1.0f)*0.5f), (int)std::floor((1.0f - y)*0.5f));
+}
+
+void TerrainWorld::SetIndexLayout(const IndexLayout layout)
+{
+    mIndexLayout = layout;
+    if(mGridIndices && mGridIndices->layout != layout)
+    {
+        mGridIndices = GridIndexCache::Acquire(mGridSize, layout);
+        mMesh.SetIndices(&mGridIndices->buffer);
+    }
+}
+
+int TerrainWorld::GetDistance(const TerrainChunk& chunk) const
+{
+    return std::max(std::abs(chunk.x - mCenterX), std::abs(chunk.y - mCenterY));
+}
+
+bool TerrainWorld::IsInView(const TerrainChunk& chunk) const
+{
+    return GetDistance(chunk) <= mViewRadius;
+}
+
+void TerrainWorld::Update(const float cameraX, const float cameraY)
+{
+    const Key center = GetChunkAt(cameraX, cameraY);
+    mCenterX = center.first;
+    mCenterY = center.second;
+
+    // Textures one chunk past the view are kept, so the camera can cross
+    // back over a chunk border without reloading
+    for(auto it = mChunks.begin(); it != mChunks.end(); ++it)
+    {
+        TerrainChunk& chunk = *it->second;
+        if(chunk.texture.GetID() != 0 && GetDistance(chunk) > mViewRadius + 1)
+        {
+            EvictTexture(chunk);
+        }
+    }
+
+    // Upload finished chunks in view, nearest first
+    std::vector<TerrainChunk*> ready;
+    int pending = 0;
+    for(auto it = mChunks.begin(); it != mChunks.end(); ++it)
+    {
+        TerrainChunk& chunk = *it->second;
+        if(!chunk.generated.load())
+        {
+            pending++;
+            continue;
+        }
+        if(!chunk.aproned)
+        {
+            ShareEdges(chunk);
+        }
+        if(chunk.texture.GetID() == 0 && chunk.heights.GetWidth() > 0 && IsInView(chunk))
+        {
+            ready.push_back(&chunk);
+        }
+    }
+    std::sort(ready.begin(), ready.end(), [this](const TerrainChunk* a, const TerrainChunk* b)
+    {
+        return GetDistance(*a) < GetDistance(*b);
+    });
+    const size_t textureBytes = (size_t)(mGridSize + 2)*(mGridSize + 2)*Texture::GetTexelSize(GL_R32F);
+    for(int i = 0; i < (int)ready.size() && i < mUploadsPerUpdate; i++)
+    {
+        if(mStats.gpuBytes + textureBytes > mGpuBudget && !EvictFarthest(true, GetDistance(*ready[i])))
+        {
+            break;
+        }
+        UploadChunk(*ready[i]);
+    }
+
+    // Start missing chunks in rings around the camera
+    const size_t heightBytes = HeightField::GetSizeInBytesFor(mGridSize, mGridSize);
+    for(int ring = 0; ring <= mViewRadius && pending < mMaxPending; ring++)
+    {
+        for(int y = mCenterY - ring; y <= mCenterY + ring && pending < mMaxPending; y++)
+        {
+            // Only the outline of the ring is new
+            const int step = (y == mCenterY - ring || y == mCenterY + ring) ? 1 : 2*ring;
+            for(int x = mCenterX - ring; x <= mCenterX + ring && pending < mMaxPending; x += step)
+            {
+                if(mChunks.count(Key(x, y)) != 0)
+                {
+                    continue;
+                }
+                if(mStats.cpuBytes + heightBytes > mCpuBudget && !EvictFarthest(false, ring))
+                {
+                    // Nothing left to make room with, retry next frame
+                    pending = mMaxPending;
+                    break;
+                }
+                StartChunk(x, y);
+                pending++;
+            }
+        }
+    }
+
+    // Chunks holding nothing are forgotten, they regenerate identically
+    for(auto it = mChunks.begin(); it != mChunks.end();)
+    {
+        const TerrainChunk& chunk = *it->second;
+        if(chunk.generated.load() && chunk.heights.GetWidth() == 0 && chunk.texture.GetID() == 0)
+        {
+            it = mChunks.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    UpdateStats();
+}
+
+TerrainChunk* TerrainWorld::FindChunk(const int x, const int y)
+{
+    auto it = mChunks.find(Key(x, y));
+    return it != mChunks.end() ? it->second.get() : nullptr;
+}
+
+void TerrainWorld::StartChunk(const int x, const int y)
+{
+    std::shared_ptr<TerrainChunk> chunk = std::make_shared<TerrainChunk>(x, y);
+    mChunks[Key(x, y)] = chunk;
+    // Counted from the start, the worker allocates exactly this much
+    mStats.cpuBytes += HeightField::GetSizeInBytesFor(mGridSize, mGridSize);
+    mStats.generated++;
+
+    const unsigned char detailLevel = mDetailLevel;
+    const float range = mRange;
+    const unsigned int seed = mSeed;
+    ThreadPool::GetShared().Enqueue([chunk, detailLevel, range, seed]()
+    {
+        GenerateChunk(chunk->heights, detailLevel, range, seed, chunk->x, chunk->y, chunk->minElevation, chunk->maxElevation);
+        const int n = chunk->heights.GetWidth();
+        for(int side = 0; side < 4; side++)
+        {
+            chunk->innerEdges[side].resize(n);
+            for(int k = 0; k < n; k++)
+            {
+                chunk->innerEdges[side][k] = SideHeight(chunk->heights, side, k, 1);
+            }
+        }
+        chunk->generated.store(true);
+    });
+}
+
+void TerrainWorld::UploadChunk(TerrainChunk& chunk)
+{
+    const HeightField& heights = chunk.heights;
+    const int n = mGridSize;
+    const int size = n + 2;
+    mTexels.resize((size_t)size*size);
+    for(int i = 0; i < n; i++)
+    {
+        std::copy(heights.Row(i), heights.Row(i) + n, &mTexels[(size_t)(i + 1)*size + 1]);
+    }
+    // The apron takes the inner edge of each generated neighbour. Missing
+    // ones are extrapolated, which gives the one sided difference, and are
+    // patched by ShareEdges once they are generated.
+    for(int side = 0; side < 4; side++)
+    {
+        const TerrainChunk* neighbour = FindChunk(chunk.x + SIDE_DX[side], chunk.y + SIDE_DY[side]);
+        const bool known = neighbour != nullptr && neighbour->generated.load();
+        int x, y, dx, dy;
+        GetApron(side, n, x, y, dx, dy);
+        for(int k = 0; k < n; k++)
+        {
+            mTexels[(size_t)(y + k*dy)*size + x + k*dx] = known ? neighbour->innerEdges[side ^ 1][k]
+                : 2.0f*SideHeight(heights, side, k, 0) - SideHeight(heights, side, k, 1);
+        }
+    }
+    // Corners of the apron are never read
+    mTexels[0] = mTexels[size - 1] = mTexels[(size_t)(size - 1)*size] = mTexels[(size_t)size*size - 1] = 0.0f;
+    chunk.texture.CreateTexture(GL_R32F, size, size, GL_RED, GL_FLOAT, mTexels.data());
+    mStats.gpuBytes += chunk.texture.GetSize();
+    mStats.uploaded++;
+    mMinElevation = chunk.minElevation < mMinElevation ? chunk.minElevation : mMinElevation;
+    mMaxElevation = chunk.maxElevation > mMaxElevation ? chunk.maxElevation : mMaxElevation;
+
+    if(!mGridIndices)
+    {
+        mGridIndices = GridIndexCache::Acquire(mGridSize, mIndexLayout);
+        mMesh.DisableVerticies(0);
+        mMesh.DisableVerticies(1);
+        mMesh.SetIndices(&mGridIndices->buffer);
+    }
+}
+
+void TerrainWorld::ShareEdges(TerrainChunk& chunk)
+{
+    for(int side = 0; side < 4; side++)
+    {
+        TerrainChunk* neighbour = FindChunk(chunk.x + SIDE_DX[side], chunk.y + SIDE_DY[side]);
+        if(neighbour == nullptr || neighbour->texture.GetID() == 0)
+        {
+            continue;
+        }
+        // This side is the neighbour's opposite one
+        int x, y, dx, dy;
+        GetApron(side ^ 1, mGridSize, x, y, dx, dy);
+        neighbour->texture.UpdateRegion(x, y, dx != 0 ? mGridSize : 1, dy != 0 ? mGridSize : 1,
+            GL_RED, GL_FLOAT, chunk.innerEdges[side].data());
+    }
+    chunk.aproned = true;
+}
+
+void TerrainWorld::EvictTexture(TerrainChunk& chunk)
+{
+    mStats.gpuBytes -= chunk.texture.GetSize();
+    mStats.evicted++;
+    chunk.texture.Release();
+}
+
+bool TerrainWorld::EvictFarthest(const bool gpu, const int distance)
+{
+    TerrainChunk* farthest = nullptr;
+    int farthestDistance = -1;
+    for(auto it = mChunks.begin(); it != mChunks.end(); ++it)
+    {
+        TerrainChunk& chunk = *it->second;
+        const int d = GetDistance(chunk);
+        bool held;
+        bool evictable;
+        if(gpu)
+        {
+            held = chunk.texture.GetID() != 0;
+            evictable = d > distance;
+        }
+        else
+        {
+            // Heights of a chunk already on the GPU are only a cache
+            held = chunk.generated.load() && chunk.heights.GetWidth() > 0;
+            evictable = d > distance || chunk.texture.GetID() != 0;
+        }
+        if(held && evictable && d > farthestDistance)
+        {
+            farthest = &chunk;
+            farthestDistance = d;
+        }
+    }
+    if(farthest == nullptr)
+    {
+        return false;
+    }
+    if(gpu)
+    {
+        EvictTexture(*farthest);
+    }
+    else
+    {
+        mStats.cpuBytes -= farthest->heights.GetSizeInBytes();
+        farthest->heights = HeightField();
+    }
+    return true;
+}
+
+void TerrainWorld::UpdateStats()
+{
+    mStats.residentChunks = 0;
+    mStats.cachedChunks = 0;
+    mStats.pendingChunks = 0;
+    for(auto it = mChunks.begin(); it != mChunks.end(); ++it)
+    {
+        const TerrainChunk& chunk = *it->second;
+        if(!chunk.generated.load())
+        {
+            mStats.pendingChunks++;
+            continue;
+        }
+        mStats.residentChunks += chunk.texture.GetID() != 0 ? 1 : 0;
+        mStats.cachedChunks += chunk.heights.GetWidth() > 0 ? 1 : 0;
+    }
+}
+
+void TerrainWorld::Render(Shader* shader)
+{
+    if(!mGridIndices)
+    {
+        return;
+    }
+    shader->Bind();
+    glUniform1i(6, 1);
+    glUniform1i(7, mGridSize);
+    glUniform1i(8, 0);
+    glUniform1i(10, 0);
+    glUniform1i(18, 1);
+    for(auto it = mChunks.begin(); it != mChunks.end(); ++it)
+    {
+        const TerrainChunk& chunk = *it->second;
+        if(chunk.texture.GetID() == 0)
+        {
+            continue;
+        }
+        chunk.texture.Bind(0);
+        glUniform2f(9, 2.0f*(float)chunk.x, -2.0f*(float)chunk.y);
+        mMesh.Render(shader, mGridIndices->primitive);
+    }
+    glUniform2f(9, 0.0f, 0.0f);
+    glUniform1i(18, 0);
+}
+
+void TerrainWorld::Release()
+{
+    // Workers still generating hold their own reference to the chunk
+    mChunks.clear();
+    mGridIndices.reset();
+    mStats = TerrainWorldStats();
+}
@@ -0,0 +1,126 @@
+/*
+ * Copyright (c) 2018 Brendan Barnes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "Texture.h"
+
+Texture::Texture()
+    : mID(0), mWidth(0), mHeight(0), mInternalFormat(0), mSize(0)
+{
+
+}
+
+Texture::~Texture()
+{
+    Release();
+}
+
+void Texture::CreateTexture(GLenum internalFormat, int width, int height,
+    GLenum format, GLenum type, const void* data, int rowLength)
+{
+    if(mID == 0 || width != mWidth || height != mHeight || internalFormat != mInternalFormat)
+    {
+        // Immutable storage can't be resized, so start over with a new name
+        Release();
+        GLCall( glGenTextures(1, &mID) );
+        GLCall( glBindTexture(GL_TEXTURE_2D, mID) );
+        GLCall( glTexStorage2D(GL_TEXTURE_2D, 1, internalFormat, width, height) );
+        GLCall( glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST) );
+        GLCall( glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST) );
+        GLCall( glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE) );
+        GLCall( glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE) );
+        mWidth = width;
+        mHeight = height;
+        mInternalFormat = internalFormat;
+        mSize = (size_t)width*height*GetTexelSize(internalFormat);
+        GpuMemory::Allocated(mSize);
+    }
+    if(data != nullptr)
+    {
+        Update(format, type, data, rowLength);
+    }
+}
+
+void Texture::Update(GLenum format, GLenum type, const void* data, int rowLength)
+{
+    GLCall( glBindTexture(GL_TEXTURE_2D, mID) );
+    GLCall( glPixelStorei(GL_UNPACK_ALIGNMENT, 1) );
+    GLCall( glPixelStorei(GL_UNPACK_ROW_LENGTH, rowLength) );
+    GLCall( glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, mWidth, mHeight, format, type, data) );
+    GLCall( glPixelStorei(GL_UNPACK_ROW_LENGTH, 0) );
+    GLCall( glPixelStorei(GL_UNPACK_ALIGNMENT, 4) );
+}
+
+void Texture::UpdateRegion(int x, int y, int width, int height, GLenum format, GLenum type, const void* data, int rowLength)
+{
+    GLCall( glBindTexture(GL_TEXTURE_2D, mID) );
+    GLCall( glPixelStorei(GL_UNPACK_ALIGNMENT, 1) );
+    GLCall( glPixelStorei(GL_UNPACK_ROW_LENGTH, rowLength) );
+    GLCall( glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height, format, type, data) );
+    GLCall( glPixelStorei(GL_UNPACK_ROW_LENGTH, 0) );
+    GLCall( glPixelStorei(GL_UNPACK_ALIGNMENT, 4) );
+}
+
+void Texture::Release()
+{
+    if(mID != 0)
+    {
+        GLCall( glDeleteTextures(1, &mID) );
+        GpuMemory::Freed(mSize);
+    }
+    mID = 0;
+    mWidth = 0;
+    mHeight = 0;
+    mInternalFormat = 0;
+    mSize = 0;
+}
+
+size_t Texture::GetTexelSize(GLenum internalFormat)
+{
+    switch(internalFormat)
+    {
+        case GL_R8:
+            return 1;
+        case GL_R16:
+        case GL_R16F:
+        case GL_RG8:
+            return 2;
+        case GL_RG16:
+        case GL_RG16F:
+        case GL_RGBA8:
+            return 4;
+        case GL_RG32F:
+        case GL_RGBA16:
+        case GL_RGBA16F:
+            return 8;
+        case GL_RGBA32F:
+            return 16;
+        default:
+            return 4;
+    }
+}
+
+void Texture::Bind(unsigned int unit) const
+{
+    GLCall( glActiveTexture(GL_TEXTURE0 + unit) );
+    GLCall( glBindTexture(GL_TEXTURE_2D, mID) );
+}
@@ -0,0 +1,198 @@
+/*
+ * Copyright (c) 2018 Brendan Barnes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "ThreadPool.h"
+#include <atomic>
+#include <exception>
+#include <memory>
+
+namespace
+{
+    // Bookkeeping for one ParallelFor call. Helpers that are dequeued after
+    // all bands were claimed still touch it, so it is reference counted.
+    struct ParallelJob
+    {
+        std::function<void(int, int)> func;
+        int count;
+        int bandSize;
+        int bandCount;
+        std::atomic<int> nextBand;
+        std::atomic<int> finishedBands;
+        std::atomic<bool> failed;   // Later bands are skipped once one throws
+        std::exception_ptr error;   // First exception thrown, under mutex
+        std::mutex mutex;
+        std::condition_variable done;
+    };
+
+    void RunBands(ParallelJob& job)
+    {
+        int band;
+        while((band = job.nextBand.fetch_add(1)) < job.bandCount)
+        {
+            int begin = band*job.bandSize;
+            int end = begin + job.bandSize < job.count ? begin + job.bandSize : job.count;
+            try
+            {
+                if(!job.failed.load())
+                {
+                    job.func(begin, end);
+                }
+            }
+            catch(...)
+            {
+                // Counted as finished below, the caller rethrows it
+                std::lock_guard<std::mutex> lock(job.mutex);
+                if(!job.error)
+                {
+                    job.error = std::current_exception();
+                }
+                job.failed.store(true);
+            }
+            if(job.finishedBands.fetch_add(1) + 1 == job.bandCount)
+            {
+                std::lock_guard<std::mutex> lock(job.mutex);
+                job.done.notify_all();
+            }
+        }
+    }
+}
+
+ThreadPool::ThreadPool(unsigned int threadCount)
+    : mStopping(false)
+{
+    if(threadCount == 0)
+    {
+        threadCount = std::thread::hardware_concurrency();
+        threadCount = threadCount > 1 ? threadCount - 1 : 1;
+    }
+    for(unsigned int i = 0; i < threadCount; i++)
+    {
+        mWorkers.push_back(std::thread(&ThreadPool::WorkerLoop, this));
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+    }
+    mCondition.notify_all();
+    for(size_t i = 0; i < mWorkers.size(); i++)
+    {
+        mWorkers[i].join();
+    }
+}
+
+void ThreadPool::Enqueue(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mTasks.push(std::move(task));
+    }
+    mCondition.notify_one();
+}
+
+void ThreadPool::ParallelFor(int count, unsigned int maxThreads, const std::function<void(int, int)>& func)
+{
+    if(count <= 0)
+    {
+        return;
+    }
+    unsigned int threads = GetThreadCount() + 1;
+    if(maxThreads != 0 && maxThreads < threads)
+    {
+        threads = maxThreads;
+    }
+    if(threads <= 1 || count == 1)
+    {
+        func(0, count);
+        return;
+    }
+
+    // A few bands per thread so uneven bands still balance out
+    std::shared_ptr<ParallelJob> job = std::make_shared<ParallelJob>();
+    job->func = func;
+    job->count = count;
+    job->bandSize = (count + 4*threads - 1)/(4*threads);
+    job->bandCount = (count + job->bandSize - 1)/job->bandSize;
+    job->nextBand = 0;
+    job->finishedBands = 0;
+    job->failed = false;
+
+    unsigned int helpers = threads - 1;
+    if(helpers > (unsigned int)job->bandCount - 1)
+    {
+        helpers = job->bandCount - 1;
+    }
+    for(unsigned int i = 0; i < helpers; i++)
+    {
+        Enqueue([job]() { RunBands(*job); });
+    }
+    RunBands(*job);
+
+    std::unique_lock<std::mutex> lock(job->mutex);
+    job->done.wait(lock, [&job]() { return job->finishedBands.load() == job->bandCount; });
+    if(job->error)
+    {
+        std::rethrow_exception(job->error);
+    }
+}
+
+ThreadPool& ThreadPool::GetShared()
+{
+    static ThreadPool pool;
+    return pool;
+}
+
+void ThreadPool::SharedParallelFor(int count, unsigned int maxThreads, const std::function<void(int, int)>& func)
+{
+    if(maxThreads == 1)
+    {
+        if(count > 0)
+        {
+            func(0, count);
+        }
+        return;
+    }
+    GetShared().ParallelFor(count, maxThreads, func);
+}
+
+void ThreadPool::WorkerLoop()
+{
+    while(true)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mCondition.wait(lock, [this]() { return mStopping || !mTasks.empty(); });
+            if(mStopping && mTasks.empty())
+            {
+                return;
+            }
+            task = std::move(mTasks.front());
+            mTasks.pop();
+        }
+        task();
+    }
+}
@@ -24,21 +24,63 @@
 #include "VertexBuffer.h"
 
 VertexBuffer::VertexBuffer()
+    : mID(0), mCount(0), mSize(0)
 {
 
 }
 
 VertexBuffer::~VertexBuffer()
 {
-    GLCall( glDeleteBuffers(1, &mID) );
+    Release();
 }
 
 void VertexBuffer::CreateBuffer(const void* data, unsigned int count, unsigned int vertexSize)
 {
+    const size_t size = (size_t)count*vertexSize;
     mCount = count;
-    GLCall( glGenBuffers(1, &mID) );
+    if(mID == 0)
+    {
+        GLCall( glGenBuffers(1, &mID) );
+    }
     GLCall( glBindBuffer(GL_ARRAY_BUFFER, mID) );
-    GLCall( glBufferData(GL_ARRAY_BUFFER, count * vertexSize, data, GL_STATIC_DRAW) );
+    if(size == mSize)
+    {
+        if(data != nullptr)
+        {
+            GLCall( glBufferSubData(GL_ARRAY_BUFFER, 0, size, data) );
+        }
+        return;
+    }
+    GLCall( glBufferData(GL_ARRAY_BUFFER, size, data, GL_STATIC_DRAW) );
+    GpuMemory::Freed(mSize);
+    GpuMemory::Allocated(size);
+    mSize = size;
+}
+
+void VertexBuffer::UpdateBuffer(const void* data, size_t offset, size_t size)
+{
+    GLCall( glBindBuffer(GL_ARRAY_BUFFER, mID) );
+    GLCall( glBufferSubData(GL_ARRAY_BUFFER, offset, size, data) );
+}
+
+void VertexBuffer::CopyBuffer(GLuint source, size_t offset, unsigned int count, unsigned int vertexSize)
+{
+    CreateBuffer(nullptr, count, vertexSize);
+    GLCall( glBindBuffer(GL_COPY_READ_BUFFER, source) );
+    GLCall( glBindBuffer(GL_COPY_WRITE_BUFFER, mID) );
+    GLCall( glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, offset, 0, mSize) );
+}
+
+void VertexBuffer::Release()
+{
+    if(mID != 0)
+    {
+        GLCall( glDeleteBuffers(1, &mID) );
+        GpuMemory::Freed(mSize);
+    }
+    mID = 0;
+    mCount = 0;
+    mSize = 0;
 }
 
 void VertexBuffer::Bind() const
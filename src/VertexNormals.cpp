@@ -0,0 +1,123 @@
+/*
+ * Copyright (c) 2018 Brendan Barnes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+#include "VertexNormals.h"
+#include "ThreadPool.h"
+#include <math.h>
+
+#ifdef TERRAIN_X86
+#include <immintrin.h>
+#endif
+
+// Normal of one cell from its four neighbours. scaleX/scaleY are 1 for
+// central differences and 2 where the difference is one sided.
+static inline void NormalCell(float left, float right, float up, float down,
+    float scaleX, float scaleY, float twoSpacing, float* normal)
+{
+    float nx = (left - right)*scaleX;
+    float ny = (down - up)*scaleY;
+    float inv = 1.0f/sqrtf(nx*nx + ny*ny + twoSpacing*twoSpacing);
+    normal[0] = nx*inv;
+    normal[1] = ny*inv;
+    normal[2] = twoSpacing*inv;
+}
+
+// Interior cells [x0, x1) of one row
+static void NormalRowScalar(const float* up, const float* row, const float* down, int x0, int x1,
+    float scaleY, float twoSpacing, float* normals)
+{
+    for(int x = x0; x < x1; x++)
+    {
+        NormalCell(row[x-1], row[x+1], up[x], down[x], 1.0f, scaleY, twoSpacing, normals + 3*x);
+    }
+}
+
+#ifdef TERRAIN_X86
+__attribute__((target("avx2")))
+static void NormalRowAVX2(const float* up, const float* row, const float* down, int x0, int x1,
+    float scaleY, float twoSpacing, float* normals)
+{
+    const __m256 vScaleY = _mm256_set1_ps(scaleY);
+    const __m256 vScaleX = _mm256_set1_ps(1.0f);
+    const __m256 nz = _mm256_set1_ps(twoSpacing);
+    const __m256 nz2 = _mm256_mul_ps(nz, nz);
+    const __m256 one = _mm256_set1_ps(1.0f);
+    alignas(32) float lanes[3][8];
+    int x = x0;
+    for(; x + 8 <= x1; x += 8)
+    {
+        __m256 nx = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(row + x - 1), _mm256_loadu_ps(row + x + 1)), vScaleX);
+        __m256 ny = _mm256_mul_ps(_mm256_sub_ps(_mm256_loadu_ps(down + x), _mm256_loadu_ps(up + x)), vScaleY);
+        __m256 len2 = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(nx, nx), _mm256_mul_ps(ny, ny)), nz2);
+        __m256 inv = _mm256_div_ps(one, _mm256_sqrt_ps(len2));
+        _mm256_store_ps(lanes[0], _mm256_mul_ps(nx, inv));
+        _mm256_store_ps(lanes[1], _mm256_mul_ps(ny, inv));
+        _mm256_store_ps(lanes[2], _mm256_mul_ps(nz, inv));
+        float* out = normals + 3*x;
+        for(int i = 0; i < 8; i++)
+        {
+            out[3*i+0] = lanes[0][i];
+            out[3*i+1] = lanes[1][i];
+            out[3*i+2] = lanes[2][i];
+        }
+    }
+    _mm256_zeroupper();
+    NormalRowScalar(up, row, down, x, x1, scaleY, twoSpacing, normals);
+}
+#endif
+
+void ComputeVertexNormals(HeightFieldView<const float> map, float spacing, vmath::vec3* normals,
+    unsigned int threadCount, SimdLevel level)
+{
+    const int width = map.GetWidth();
+    const int height = map.GetHeight();
+    if(width < 2 || height < 2)
+    {
+        return;
+    }
+
+    const float twoSpacing = 2.0f*spacing;
+    void (*normalRow)(const float*, const float*, const float*, int, int, float, float, float*) = NormalRowScalar;
+#ifdef TERRAIN_X86
+    if(level == SimdLevel::AVX2 && GetBestSimdLevel() == SimdLevel::AVX2)
+    {
+        normalRow = NormalRowAVX2;
+    }
+#endif
+    ThreadPool::SharedParallelFor(height, threadCount, [&](int first, int last)
+    {
+        for(int y = first; y < last; y++)
+        {
+            // Edge rows and columns fall back to one sided differences
+            const float* row = map.Row(y);
+            const float* up = y > 0 ? map.Row(y-1) : row;
+            const float* down = y < height-1 ? map.Row(y+1) : row;
+            const float scaleY = (y > 0 && y < height-1) ? 1.0f : 2.0f;
+            float* out = &normals[(size_t)y*width][0];
+
+            NormalCell(row[0], row[1], up[0], down[0], 2.0f, scaleY, twoSpacing, out);
+            normalRow(up, row, down, 1, width-1, scaleY, twoSpacing, out);
+            NormalCell(row[width-2], row[width-1], up[width-1], down[width-1], 2.0f, scaleY, twoSpacing, out + 3*(width-1));
+        }
+    });
+}
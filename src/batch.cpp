@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2018 Brendan Barnes
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice (including the next
+ * paragraph) shall be included in all copies or substantial portions of the
+ * Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ * DEALINGS IN THE SOFTWARE.
+ */
+
+// Batch DEM generation, no window or GL needed
+// Usage: batch [-o directory] [-l level | -l min-max] [-s firstSeed] [-n seeds]
+//              [-j workers] [-q buffersPerWorker] [-r range] [-f raw|png|bil] [-d 0|1]
+// Writes dem_<seed>_<level>.<format> for every seed and level, see TerrainBatch.h.
+// -d 1 writes with O_DIRECT.
+
+#include "TerrainBatch.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sys/stat.h>
+
+int main(int argc, char** argv)
+{
+    TerrainBatch batch;
+    const char* directory = "dem";
+    int minLevel = 8, maxLevel = 10;
+    uint32_t firstSeed = 1, seedCount = 100;
+    for(int i = 1; i < argc; i += 2)
+    {
+        // Every option takes a value
+        if(i + 1 == argc)
+        {
+            std::cout << "Missing value for " << argv[i] << std::endl;
+            return 1;
+        }
+        const char* value = argv[i + 1];
+        if(strcmp(argv[i], "-o") == 0)
+        {
+            directory = value;
+        }
+        else if(strcmp(argv[i], "-l") == 0)
+        {
+            // A single level or an inclusive range
+            if(sscanf(value, "%d-%d", &minLevel, &maxLevel) < 2)
+            {
+                maxLevel = minLevel;
+            }
+        }
+        else if(strcmp(argv[i], "-s") == 0)
+        {
+            firstSeed = (uint32_t)strtoul(value, nullptr, 10);
+        }
+        else if(strcmp(argv[i], "-n") == 0)
+        {
+            seedCount = (uint32_t)strtoul(value, nullptr, 10);
+        }
+        else if(strcmp(argv[i], "-j") == 0)
+        {
+            batch.SetWorkerCount(atoi(value));
+        }
+        else if(strcmp(argv[i], "-q") == 0)
+        {
+            batch.SetBuffersPerWorker(atoi(value));
+        }
+        else if(strcmp(argv[i], "-r") == 0)
+        {
+            batch.SetRange((float)atof(value));
+        }
+        else if(strcmp(argv[i], "-f") == 0)
+        {
+            HeightFileFormat format;
+            if(!HeightFieldWriter::ParseFormat(value, format))
+            {
+                std::cout << "Unknown format " << value << ", use raw, png or bil" << std::endl;
+                return 1;
+            }
+            batch.SetFormat(format);
+        }
+        else if(strcmp(argv[i], "-d") == 0)
+        {
+            batch.SetDirectIO(atoi(value) != 0);
+        }
+        else
+        {
+            std::cout << "Unknown option " << argv[i] << std::endl;
+            return 1;
+        }
+    }
+    if(minLevel < 1 || maxLevel > 15 || minLevel > maxLevel)
+    {
+        std::cout << "Detail levels must be within 1-15" << std::endl;
+        return 1;
+    }
+    batch.SetDetailLevels((unsigned char)minLevel, (unsigned char)maxLevel);
+    batch.SetSeeds(firstSeed, seedCount);
+
+    mkdir(directory, 0755);
+    batch.SetOutputDirectory(directory);
+    std::cout << "Generating " << batch.GetJobCount() << " terrains, levels " << minLevel << "-" << maxLevel
+              << ", on " << batch.GetWorkerCount() << " workers into " << directory << std::endl;
+
+    const TerrainBatchStats stats = batch.Run();
+    const double megabytes = stats.bytes/(1024.0*1024.0);
+    printf("%zu terrains, %.1f MB in %.2f s: %.1f terrains/s, %.1f MB/s\n", stats.terrains, megabytes,
+        stats.seconds, stats.terrains/stats.seconds, megabytes/stats.seconds);
+    printf("Workers waited %.2f s for the writer, at most %zu terrains queued, %.1f MB of heightmaps\n",
+        stats.stallSeconds, stats.peakQueued, stats.bufferBytes/(1024.0*1024.0));
+    if(stats.failed > 0)
+    {
+        printf("%zu terrains could not be written\n", stats.failed);
+        return 1;
+    }
+    return 0;
+}
@@ -27,17 +27,38 @@
 #include "VertexBuffer.h"
 #include "IndexBuffer.h"
 #include "Terrain.h"
+#include "TerrainWorld.h"
+#include "GeometryClipmap.h"
+#include <cstdio>
+#include <ctime>
 
 class Test : public Game
 {
+public:
+    int headlessFrames = 0;         // Frames to render without a window, 0 opens one
+    const char* headlessOutput = "";    // Where the last headless frame is saved
+
+private:
     vmath::vec4 bgColor;            // Background color
     Shader renderShader;            // Shader program
+    Shader tessShader;              // Program for TerrainRenderMode::TESSELLATION
+    Shader clipmapShader;           // Program for the GeometryClipmap
     vmath::mat4 projection;         // Projection matrix
     float aspect = 800.0f/600.0f;   // Aspect ratio
     int previousAction = 0;         // GLFW previous keyboard action
     bool wireframe = false;         // Wireframe mode
     Terrain terrain;                // Terrain Digital Elevation Model (DEM)
     float zoom = 0.0;
+    unsigned int seed;              // Terrain seed, 'R' moves to the next one
+    std::shared_ptr<TerrainJob> job;    // Latest background generation
+    int shownProgress = -1;         // Percentage in the window title
+    std::unique_ptr<TerrainWorld> world;    // Streamed chunks, 'C' switches to it
+    float cameraX = 0.0f;           // World position the chunks stream around
+    float cameraY = 0.0f;
+    std::pair<int, int> cameraChunk;
+    std::unique_ptr<GeometryClipmap> clipmap;   // Clipmap around the camera, 'G' switches to it
+    size_t reportedTexels = 0;      // Clipmap upload total at the last report
+    double statsReportTime = 0.0;   // Last time the periodic stats were printed
 
     // Initialize settings
     void init()
@@ -50,6 +71,10 @@ class Test : public Game
         info.samples = 16;
         info.flags.all = 0;
         info.flags.cursor = 1;
+        info.flags.headless = headlessFrames > 0 ? 1 : 0;
+        info.frames = headlessFrames;
+        strncpy(info.output, headlessOutput, sizeof(info.output) - 1);
+        info.output[sizeof(info.output) - 1] = '\0';
     }
 
     // Start-up operations
@@ -58,20 +83,102 @@ class Test : public Game
         bgColor = vmath::vec4(0.9f, 0.9f, 0.9f, 1.0f);
         std::string shaderPath = "res/shaders/render.glsl";
         renderShader = Shader(shaderPath);
+        std::string tessShaderPath = "res/shaders/tessellation.glsl";
+        tessShader = Shader(tessShaderPath);
+        std::string clipmapShaderPath = "res/shaders/clipmap.glsl";
+        clipmapShader = Shader(clipmapShaderPath);
         
         // Generate terrain DEM
-        terrain.GenTerrain(10, 0.7f);
+        terrain.SetIndexLayout(IndexLayout::TRIANGLE_STRIP);
+        terrain.SetProgressive(257);
+        seed = (unsigned int)time(NULL);
+        std::cout << "Terrain seed: " << seed << std::endl;
+        terrain.GenTerrain(10, 0.7f, seed);
 
         // Culling and depth testing
         glEnable(GL_CULL_FACE);
         glCullFace(GL_FRONT);
         glEnable(GL_DEPTH_TEST);
         glDepthFunc(GL_LESS);
+
+        // Strips are split with the maximum index
+        glEnable(GL_PRIMITIVE_RESTART_FIXED_INDEX);
+    }
+
+    // Sizes and upload stats of the terrain on screen
+    void printTerrainStats()
+    {
+        const RingBufferStats& staging = terrain.GetStagingStats();
+        std::cout << "Vertex bytes: " << terrain.GetVertexBytes() << ", height bytes: " << terrain.GetHeightBytes();
+        if(terrain.GetQuantizationError() > 0.0f)
+        {
+            std::cout << ", max error " << terrain.GetQuantizationError()
+                << " (step " << (terrain.maxElevation - terrain.minElevation)/QUANTIZED_HEIGHT_MAX << ")";
+        }
+        std::cout << std::endl;
+        std::cout << "GPU memory held: " << GpuMemory::GetBytesHeld() << " bytes (" << terrain.GetStagingBytes()
+            << " in the staging ring), " << staging.stalls << " of "
+            << staging.reservations << " uploads stalled (" << staging.stallMilliseconds << " ms)" << std::endl;
+    }
+
+    // Size of the RTIN mesh on screen
+    void printRtinStats()
+    {
+        const RtinStats& rtin = terrain.GetRtinStats();
+        size_t full = 2*(size_t)(terrain.GetGridSize() - 1)*(terrain.GetGridSize() - 1);
+        std::cout << "RTIN: " << rtin.vertices << " vertices, " << rtin.triangles << " triangles ("
+            << (rtin.triangles > 0 ? full/rtin.triangles : 0) << "x fewer than the grid), midpoint error within " << rtin.maxError << std::endl;
+    }
+
+    // Texels the camera moves since the last report uploaded
+    void printClipmapStats()
+    {
+        const ClipmapStats& stats = clipmap->GetStats();
+        std::cout << "Clipmap: " << stats.totalUploadedTexels - reportedTexels << " texels uploaded, " << stats.totalUploadedTexels
+            << " in total, " << stats.triangles << " triangles, " << stats.gpuBytes << " GPU bytes" << std::endl;
+        reportedTexels = stats.totalUploadedTexels;
+    }
+
+    // Chunk counts and memory of the streamed world
+    void printWorldStats()
+    {
+        const TerrainWorldStats& stats = world->GetStats();
+        std::cout << "Chunk (" << cameraChunk.first << ", " << cameraChunk.second << "): " << stats.residentChunks
+            << " resident, " << stats.cachedChunks << " cached, " << stats.pendingChunks << " generating, "
+            << stats.gpuBytes << " GPU bytes, " << stats.cpuBytes << " CPU bytes" << std::endl;
+    }
+
+    // Regenerate in the background, the current terrain stays on screen
+    void regenerate()
+    {
+        job = terrain.GenTerrainAsync(10, 0.7f, seed);
     }
 
     // Render loop
     void render(double currentTime)
     {
+        // Swap in a finished terrain, or show how far along it is
+        if(terrain.Update())
+        {
+            printTerrainStats();
+            if(!terrain.IsGenerating())
+            {
+                setWindowTitle(info.title);
+                shownProgress = -1;
+            }
+        }
+        else if(job && !job->IsFinished())
+        {
+            int percent = (int)(100.0f*job->GetProgress());
+            if(percent != shownProgress)
+            {
+                char title[256];
+                snprintf(title, sizeof(title), "%s - generating %d%%", info.title, percent);
+                setWindowTitle(title);
+                shownProgress = percent;
+            }
+        }
+
         glClear(GL_DEPTH_BUFFER_BIT);
         glClearBufferfv(GL_COLOR, 0, bgColor);
         glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
@@ -80,22 +187,105 @@ class Test : public Game
             glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
         }
 
-        // Set shader uniforms
+        // Set shader uniforms, on the program the terrain on screen needs
+        Shader* shader = &renderShader;
+        if(clipmap)
+        {
+            shader = &clipmapShader;
+        }
+        else if(!world && terrain.GetDrawMode() == TerrainRenderMode::TESSELLATION)
+        {
+            shader = &tessShader;
+        }
+        shader->Bind();
         float t = (float)currentTime;
         glUniform1f(3, t);
+        if(world)
+        {
+            // Looking down at the camera position instead of spinning
+            world->Update(cameraX, cameraY);
+            std::pair<int, int> chunk = TerrainWorld::GetChunkAt(cameraX, cameraY);
+            if(chunk != cameraChunk)
+            {
+                cameraChunk = chunk;
+                printWorldStats();
+            }
+            glUniform1f(4, world->GetMaxElevation());
+            glUniform1f(5, world->GetMinElevation());
+            projection = vmath::perspective(60.0f, aspect, 0.001f, 100.0f) * vmath::translate(vmath::vec3(0.0f, 0.0f, -2.0f+zoom)) * vmath::rotate(45.0f, vmath::vec3(-1.0f, 0.0f, 0.0f)) * vmath::translate(vmath::vec3(-cameraX, -cameraY, 0.0f));
+            glUniformMatrix4fv(2, 1, GL_FALSE, projection);
+            world->Render(shader);
+            return;
+        }
+        if(clipmap)
+        {
+            // Same view as the streamed world
+            clipmap->Update(cameraX, cameraY);
+            // Held arrow keys upload on most frames, so report at most
+            // every couple of seconds
+            if(clipmap->GetStats().totalUploadedTexels != reportedTexels && currentTime - statsReportTime > 2.0)
+            {
+                printClipmapStats();
+                statsReportTime = currentTime;
+            }
+            glUniform1f(4, clipmap->GetMaxElevation());
+            glUniform1f(5, clipmap->GetMinElevation());
+            projection = vmath::perspective(60.0f, aspect, 0.001f, 100.0f) * vmath::translate(vmath::vec3(0.0f, 0.0f, -2.0f+zoom)) * vmath::rotate(45.0f, vmath::vec3(-1.0f, 0.0f, 0.0f)) * vmath::translate(vmath::vec3(-cameraX, -cameraY, 0.0f));
+            glUniformMatrix4fv(2, 1, GL_FALSE, projection);
+            clipmap->Render(shader);
+            return;
+        }
         glUniform1f(4, terrain.maxElevation);
         glUniform1f(5, terrain.minElevation);
-        projection = vmath::perspective(60.0f, aspect, 0.001f, 100.0f) * vmath::translate(vmath::vec3(0.0f, 0.0f, -2.0f+zoom)) * vmath::rotate(45.0f, vmath::vec3(-1.0f, 0.0f, 0.0f)) * vmath::rotate(t*5.0f, vmath::vec3(0.0f, 0.0f, -1.0f));
+        vmath::mat4 rotation = vmath::rotate(45.0f, vmath::vec3(-1.0f, 0.0f, 0.0f)) * vmath::rotate(t*5.0f, vmath::vec3(0.0f, 0.0f, -1.0f));
+        projection = vmath::perspective(60.0f, aspect, 0.001f, 100.0f) * vmath::translate(vmath::vec3(0.0f, 0.0f, -2.0f+zoom)) * rotation;
         glUniformMatrix4fv(2, 1, GL_FALSE, projection);
+
+        // The camera sits at the origin of view space, so in model space it
+        // is the translation undone by the transposed rotation (v * M is M^T v)
+        vmath::vec4 eye = vmath::vec4(0.0f, 0.0f, 2.0f-zoom, 0.0f) * rotation;
+        terrain.SetView(vmath::vec3(eye[0], eye[1], eye[2]), projection, (float)info.windowHeight, 60.0f);
         
         // Render the terrain
-        terrain.Render(&renderShader);
+        terrain.Render(shader);
+        if(currentTime - statsReportTime > 2.0)
+        {
+            if(terrain.GetDrawMode() == TerrainRenderMode::TESSELLATION)
+            {
+                std::cout << "Tessellation: " << terrain.GetPatchCount() << " patches" << std::endl;
+            }
+            else if(terrain.GetDrawMode() == TerrainRenderMode::RTIN)
+            {
+                printRtinStats();
+            }
+            else if(terrain.GetDrawMode() == TerrainRenderMode::CDLOD)
+            {
+                const CdlodStats& lod = terrain.GetLodStats();
+                std::cout << "CDLOD: " << lod.selectedNodes << " patches, " << lod.culledNodes << " culled, "
+                    << lod.triangles << " triangles" << std::endl;
+            }
+            else
+            {
+                const TerrainCullStats& cull = terrain.GetCullStats();
+                std::cout << "Chunks: " << cull.drawnChunks << " drawn, " << cull.culledChunks << " culled, "
+                    << cull.drawnTriangles << " triangles drawn, " << cull.culledTriangles << " culled" << std::endl;
+            }
+            statsReportTime = currentTime;
+        }
     }
 
     // Clean up
     void shutdown()
     {
-        terrain.~Terrain();
+        if(world)
+        {
+            world->Release();
+        }
+        if(clipmap)
+        {
+            clipmap->Release();
+        }
+        terrain.Release();
     }
 
     // Resize window callback
@@ -116,7 +306,128 @@ class Test : public Game
         }
         if(key == GLFW_KEY_R && action == GLFW_RELEASE && previousAction == GLFW_PRESS)
         {
-            terrain.GenTerrain(10, 0.7f);
+            seed++;
+            std::cout << "Terrain seed: " << seed << std::endl;
+            regenerate();
+        }
+        if(key == GLFW_KEY_T && action == GLFW_RELEASE && previousAction == GLFW_PRESS)
+        {
+            bool strips = terrain.GetIndexLayout() == IndexLayout::TRIANGLE_STRIP;
+            terrain.SetIndexLayout(strips ? IndexLayout::TRIANGLE_LIST : IndexLayout::TRIANGLE_STRIP);
+            if(world)
+            {
+                world->SetIndexLayout(terrain.GetIndexLayout());
+            }
+            std::cout << (strips ? "Triangle list: " : "Triangle strips: ") << terrain.GetIndexBytes() << " index bytes" << std::endl;
+        }
+        if(key == GLFW_KEY_V && action == GLFW_RELEASE && previousAction == GLFW_PRESS)
+        {
+            bool fromTexture = terrain.GetRenderMode() == TerrainRenderMode::HEIGHT_TEXTURE;
+            terrain.SetRenderMode(fromTexture ? TerrainRenderMode::VERTEX_ATTRIBUTES : TerrainRenderMode::HEIGHT_TEXTURE);
+            std::cout << (fromTexture ? "Vertex attributes" : "Height texture") << std::endl;
+            regenerate();
+        }
+        if(key == GLFW_KEY_Q && action == GLFW_RELEASE && previousAction == GLFW_PRESS)
+        {
+            bool quantized = terrain.GetHeightFormat() == HeightFormat::UNORM16;
+            if(terrain.GetRenderMode() == TerrainRenderMode::VERTEX_ATTRIBUTES)
+            {
+                terrain.SetRenderMode(TerrainRenderMode::HEIGHT_TEXTURE);
+            }
+            terrain.SetHeightFormat(quantized ? HeightFormat::FLOAT32 : HeightFormat::UNORM16);
+            std::cout << (quantized ? "32-bit heights" : "16-bit heights") << std::endl;
+            regenerate();
+        }
+        if(key == GLFW_KEY_L && action == GLFW_RELEASE && previousAction == GLFW_PRESS)
+        {
+            bool lod = terrain.GetRenderMode() == TerrainRenderMode::CDLOD;
+            terrain.SetRenderMode(lod ? TerrainRenderMode::HEIGHT_TEXTURE : TerrainRenderMode::CDLOD);
+            std::cout << (lod ? "Height texture" : "CDLOD patches") << std::endl;
+            regenerate();
+        }
+        if(key == GLFW_KEY_E && action == GLFW_RELEASE && previousAction == GLFW_PRESS)
+        {
+            bool tessellated = terrain.GetRenderMode() == TerrainRenderMode::TESSELLATION;
+            terrain.SetRenderMode(tessellated ? TerrainRenderMode::HEIGHT_TEXTURE : TerrainRenderMode::TESSELLATION);
+            std::cout << (tessellated ? "Height texture" : "Tessellated patches") << std::endl;
+            regenerate();
+        }
+        if(key == GLFW_KEY_M && action == GLFW_RELEASE && previousAction == GLFW_PRESS)
+        {
+            bool rtin = terrain.GetRenderMode() == TerrainRenderMode::RTIN;
+            terrain.SetRenderMode(rtin ? TerrainRenderMode::HEIGHT_TEXTURE : TerrainRenderMode::RTIN);
+            std::cout << (rtin ? "Height texture" : "RTIN mesh") << std::endl;
+            regenerate();
+        }
+        if((key == GLFW_KEY_LEFT_BRACKET || key == GLFW_KEY_RIGHT_BRACKET) && action == GLFW_RELEASE && previousAction == GLFW_PRESS)
+        {
+            float factor = key == GLFW_KEY_LEFT_BRACKET ? 0.5f : 2.0f;
+            terrain.SetRtinMaxError(terrain.GetRtinMaxError()*factor);
+            if(terrain.GetDrawMode() == TerrainRenderMode::RTIN)
+            {
+                printRtinStats();
+            }
+        }
+        if(key == GLFW_KEY_X && action == GLFW_RELEASE && previousAction == GLFW_PRESS)
+        {
+            std::string path = "terrain_" + std::to_string(seed) + ".png";
+            if(terrain.Export(path, HeightFileFormat::PNG16))
+            {
+                std::cout << "Saved the heightmap to " << path << std::endl;
+            }
+        }
+        if(key == GLFW_KEY_P && action == GLFW_RELEASE && previousAction == GLFW_PRESS)
+        {
+            terrain.SetProgressive(terrain.GetProgressive() > 0 ? 0 : 257);
+            std::cout << "Progressive previews " << (terrain.GetProgressive() > 0 ? "on" : "off") << std::endl;
+        }
+        if(key == GLFW_KEY_C && action == GLFW_RELEASE && previousAction == GLFW_PRESS)
+        {
+            if(world)
+            {
+                world->Release();
+                world.reset();
+                std::cout << "Single terrain" << std::endl;
+            }
+            else
+            {
+                if(clipmap)
+                {
+                    clipmap->Release();
+                    clipmap.reset();
+                }
+                // 129 vertex chunks, 7 x 7 of them in view
+                world.reset(new TerrainWorld(7, 0.7f, seed));
+                world->SetIndexLayout(terrain.GetIndexLayout());
+                cameraChunk = TerrainWorld::GetChunkAt(cameraX, cameraY);
+                std::cout << "Streamed world, arrow keys move" << std::endl;
+            }
+        }
+        if(key == GLFW_KEY_G && action == GLFW_RELEASE && previousAction == GLFW_PRESS)
+        {
+            if(clipmap)
+            {
+                clipmap->Release();
+                clipmap.reset();
+                std::cout << "Single terrain" << std::endl;
+            }
+            else
+            {
+                if(world)
+                {
+                    world->Release();
+                    world.reset();
+                }
+                // 8 levels of 129^2 vertices, the finest as dense as the world's chunks
+                clipmap.reset(new GeometryClipmap(8, 129, 2.0f/128.0f, 0.7f, seed));
+                reportedTexels = 0;
+                std::cout << "Geometry clipmap, arrow keys move" << std::endl;
+            }
+        }
+        if((world || clipmap) && (key == GLFW_KEY_LEFT || key == GLFW_KEY_RIGHT || key == GLFW_KEY_UP || key == GLFW_KEY_DOWN) && action != GLFW_RELEASE)
+        {
+            cameraX += key == GLFW_KEY_LEFT ? -0.25f : (key == GLFW_KEY_RIGHT ? 0.25f : 0.0f);
+            cameraY += key == GLFW_KEY_DOWN ? -0.25f : (key == GLFW_KEY_UP ? 0.25f : 0.0f);
         }
         if(key == GLFW_KEY_KP_ADD && action == GLFW_RELEASE && previousAction == GLFW_PRESS)
         {
@@ -130,10 +441,17 @@ class Test : public Game
     }
 };
 
-// Program entry point
-int main(void)
+// Program entry point. "--headless [frames] [output.ppm]" renders offscreen
+// without a display, e.g. "--headless 120 frame.ppm".
+int main(int argc, char** argv)
 {
     Test* test = new Test();
+    if(argc > 1 && strcmp(argv[1], "--headless") == 0)
+    {
+        test->headlessFrames = argc > 2 ? atoi(argv[2]) : 1;
+        test->headlessFrames = test->headlessFrames > 0 ? test->headlessFrames : 1;
+        test->headlessOutput = argc > 3 ? argv[3] : "";
+    }
     test->run(test);
     delete test;
     return 0;